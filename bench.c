@@ -0,0 +1,294 @@
+#include "asym.h"
+#include "bench_util.h"
+#include "encoding.h"
+#include "key.h"
+#include "message.h"
+#include "plwe_poly.h"
+#include "util.h"
+#include "wrapper.h"
+
+#include <gmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define BENCH_REPS 20           // Timed repetitions of every operation
+#define BENCH_WARMUP 3          // Untimed repetitions before timing
+#define BENCH_T 16              // Base of the evaluation key for relinearization
+#define BENCH_B 2               // Encoding base
+
+/// State shared by all operations of one parameter set
+struct bench_state {
+    struct settings settings;
+    struct key key;
+    struct key_eval key_eval;
+    struct plwe_poly m;         // Encoded plaintext
+    struct message enc1;        // Fresh ciphertexts
+    struct message enc2;
+    struct message deep;        // D - 1 element ciphertext, not relinearized
+    struct message product;     // D element ciphertext, deep * enc2
+    struct message square;      // 3 element ciphertext, enc1 * enc2
+    struct message result;      // Output of the timed operation, reset between repetitions
+    struct key result_key;
+    struct plwe_poly decrypted;
+};
+
+/// Operation with untimed preparation and cleanup of every repetition
+struct bench_op {
+    const char *name;
+    void (*before)(struct bench_state *state);  // NULL if not needed
+    void (*run)(struct bench_state *state);
+    void (*after)(struct bench_state *state);   // NULL if not needed
+};
+
+static void clear_key(struct key *key) {
+    plwe_poly_small_clear(&key->sk);
+    plwe_poly_clear(&key->pk_a);
+    plwe_poly_clear(&key->pk_b);
+}
+
+static void result_init(struct bench_state *state) {
+    message_init(&state->result, &state->settings);
+}
+
+static void result_init_enc1(struct bench_state *state) {
+    message_init(&state->result, &state->settings);
+    message_set(&state->result, &state->enc1);
+}
+
+static void result_init_square(struct bench_state *state) {
+    message_init(&state->result, &state->settings);
+    message_set(&state->result, &state->square);
+}
+
+static void result_clear(struct bench_state *state) {
+    message_clear(&state->result);
+}
+
+static void result_key_clear(struct bench_state *state) {
+    clear_key(&state->result_key);
+}
+
+static void run_keygen(struct bench_state *state) {
+    keygen(&state->result_key, &state->settings);
+}
+
+static void run_encrypt(struct bench_state *state) {
+    encrypt(&state->result, &state->m, &state->key);
+}
+
+static void run_encrypt_sym(struct bench_state *state) {
+    encrypt_sym(&state->result, &state->m, &state->key);
+}
+
+static void run_eval_add(struct bench_state *state) {
+    eval_add(&state->result, &state->product, &state->product);
+}
+
+static void run_eval_mul(struct bench_state *state) {
+    eval_mul(&state->result, &state->deep, &state->enc2);
+}
+
+static void run_relinearize(struct bench_state *state) {
+    message_relinearize(&state->result, &state->key_eval);
+}
+
+static void run_eval_add_plain(struct bench_state *state) {
+    eval_add_plain(&state->result, &state->enc1, &state->m);
+}
+
+static void run_eval_mul_plain(struct bench_state *state) {
+    eval_mul_plain(&state->result, &state->enc1, &state->m);
+}
+
+static void run_decrypt(struct bench_state *state) {
+    decrypt(&state->decrypted, &state->product, &state->key);
+}
+
+static const struct bench_op bench_ops[] = {
+        {"keygen", NULL, run_keygen, result_key_clear},
+        {"encrypt", result_init, run_encrypt, result_clear},
+        {"encrypt_sym", result_init, run_encrypt_sym, result_clear},
+        {"eval_add", result_init, run_eval_add, result_clear},
+        {"eval_mul", result_init, run_eval_mul, result_clear},
+        {"relinearize", result_init_square, run_relinearize, result_clear},
+        {"eval_add_plain", result_init_enc1, run_eval_add_plain, result_clear},
+        {"eval_mul_plain", result_init_enc1, run_eval_mul_plain, result_clear},
+        {"decrypt", NULL, run_decrypt, NULL},
+};
+#define BENCH_OPS (sizeof(bench_ops) / sizeof(bench_ops[0]))
+
+static void state_init(struct bench_state *state, unsigned long n_power, unsigned long qBits, unsigned long t,
+                       unsigned long D) {
+    settings_init_gen_prime(&state->settings, n_power, qBits, t, BENCH_B, D);
+
+    keygen(&state->key, &state->settings);
+    key_init_eval(&state->key_eval, &state->key, BENCH_T);
+
+    plwe_poly_init(&state->m, state->settings.q, state->settings.n);
+    plwe_poly_init(&state->decrypted, state->settings.q, state->settings.n);
+    encode_si(&state->m, 12345, BENCH_B);
+
+    message_init(&state->enc1, &state->settings);
+    message_init(&state->enc2, &state->settings);
+    message_init(&state->deep, &state->settings);
+    message_init(&state->product, &state->settings);
+    message_init(&state->square, &state->settings);
+    encrypt(&state->enc1, &state->m, &state->key);
+    encrypt(&state->enc2, &state->m, &state->key);
+    eval_mul(&state->square, &state->enc1, &state->enc2);
+
+    //Products without relinearization grow a ciphertext to D - 1 elements, the timed eval_mul produces D elements
+    message_set(&state->deep, &state->enc1);
+    while (state->deep.cIndex < D - 1) {
+        eval_mul(&state->deep, &state->deep, &state->enc2);
+    }
+    eval_mul(&state->product, &state->deep, &state->enc2);
+}
+
+static void state_clear(struct bench_state *state) {
+    message_clear(&state->enc1);
+    message_clear(&state->enc2);
+    message_clear(&state->deep);
+    message_clear(&state->product);
+    message_clear(&state->square);
+    plwe_poly_clear(&state->m);
+    plwe_poly_clear(&state->decrypted);
+
+    for (unsigned long i = 0; i <= state->key_eval.l; i++) {
+        plwe_poly_clear(&state->key_eval.ek0[i]);
+        plwe_poly_clear(&state->key_eval.ek1[i]);
+    }
+    key_clear_eval(&state->key_eval);
+    clear_key(&state->key);
+    fmpz_clear(state->settings.q);
+}
+
+/// Nearest-rank percentile of sorted samples
+static double percentile(const double *sorted, unsigned long count, double p) {
+    unsigned long rank = (unsigned long) (p / 100.0 * (double) count + 0.999999);
+    return sorted[(rank == 0) ? 0 : rank - 1];
+}
+
+/// Time an operation and write one JSON result object
+/// @param[out] json Output
+/// @param[in,out] state State of the parameter set
+/// @param[in] op Operation
+/// @param[in] reps Timed repetitions
+/// @param[in] warmup Untimed repetitions
+/// @param[in,out] first != 0 if this is the first result (see bench_json_next)
+static void bench_op_run(FILE *json, struct bench_state *state, const struct bench_op *op, unsigned long reps,
+                         unsigned long warmup, int *first) {
+    double *samples = malloc(reps * sizeof(double));
+    double total = 0;
+
+    for (unsigned long i = 0; i < warmup + reps; i++) {
+        if (op->before != NULL) {
+            op->before(state);
+        }
+
+        double start = bench_now_ns();
+        op->run(state);
+        double elapsed = bench_now_ns() - start;
+
+        if (op->after != NULL) {
+            op->after(state);
+        }
+
+        if (i >= warmup) {
+            samples[i - warmup] = elapsed;
+            total += elapsed;
+        }
+    }
+
+    bench_sort(samples, reps);
+
+    double p50 = percentile(samples, reps, 50), p95 = percentile(samples, reps, 95);
+    double p99 = percentile(samples, reps, 99);
+
+    fprintf(stderr, "n: %ld, qBits: %lu, t: %lu, D: %lu, %-15s p50: %12.0f ns, p99: %12.0f ns\n", state->settings.n,
+            state->settings.qBits, state->settings.t, state->settings.D, op->name, p50, p99);
+
+    bench_json_next(json, first);
+    fprintf(json, "{\"op\": \"%s\", \"n\": %ld, \"qBits\": %lu, \"t\": %lu, \"D\": %lu, \"reps\": %lu, "
+                  "\"throughput\": %.3f, \"mean_ns\": %.0f, \"min_ns\": %.0f, \"p50_ns\": %.0f, \"p95_ns\": %.0f, "
+                  "\"p99_ns\": %.0f, \"max_ns\": %.0f}",
+            op->name, state->settings.n, state->settings.qBits, state->settings.t,
+            state->settings.D, reps, (double) reps / (total / 1e9), total / (double) reps, samples[0], p50, p95, p99,
+            samples[reps - 1]);
+
+    free(samples);
+}
+
+int main(int argc, char **argv) {
+    struct bench_values n_powers = {{10, 12, 14}, 3};
+    struct bench_values q_bits = {{64, 128, 200}, 3};
+    struct bench_values ts = {{2000}, 1};
+    struct bench_values Ds = {{3}, 1};
+    unsigned long reps = BENCH_REPS, warmup = BENCH_WARMUP;
+    const char *output = NULL;
+
+    int opt, bad = 0;
+    while ((opt = getopt(argc, argv, "n:q:t:D:r:w:o:")) != -1) {
+        switch (opt) {
+            case 'n': bad |= bench_parse_values(&n_powers, optarg); break;
+            case 'q': bad |= bench_parse_values(&q_bits, optarg); break;
+            case 't': bad |= bench_parse_values(&ts, optarg); break;
+            case 'D': bad |= bench_parse_values(&Ds, optarg); break;
+            case 'r': reps = strtoul(optarg, NULL, 10); break;
+            case 'w': warmup = strtoul(optarg, NULL, 10); break;
+            case 'o': output = optarg; break;
+            default: bad = 1;
+        }
+    }
+
+    if (bad || reps == 0) {
+        bench_usage(argv[0], "[-n n_powers] [-q qBits] [-t t] [-D D] [-r reps] [-w warmup] [-o output.json]",
+                    "every combination is benchmarked");
+        return 1;
+    }
+
+    //Relinearization needs ciphertexts of 3 elements
+    for (unsigned long i = 0; i < Ds.count; i++) {
+        if (Ds.values[i] < 3) {
+            fprintf(stderr, "Error, D must be at least 3\n");
+            return 1;
+        }
+    }
+
+    FILE *json = (output == NULL) ? stdout : fopen(output, "w");
+    if (json == NULL) {
+        fprintf(stderr, "Error, can't open %s\n", output);
+        return 1;
+    }
+
+    fprintf(json, "{\n  \"compiler\": \"%s\",\n  \"gmp\": \"%s\",\n", __VERSION__, gmp_version);
+    fprintf(json, "  \"reps\": %lu,\n  \"warmup\": %lu,\n  \"T\": %d,\n  \"b\": %d,\n  \"results\": [", reps, warmup,
+            BENCH_T, BENCH_B);
+
+    int first = 1;
+    for (unsigned long ni = 0; ni < n_powers.count; ni++) {
+        for (unsigned long qi = 0; qi < q_bits.count; qi++) {
+            for (unsigned long ti = 0; ti < ts.count; ti++) {
+                for (unsigned long di = 0; di < Ds.count; di++) {
+                    struct bench_state state;
+                    state_init(&state, n_powers.values[ni], q_bits.values[qi], ts.values[ti], Ds.values[di]);
+
+                    for (unsigned long i = 0; i < BENCH_OPS; i++) {
+                        bench_op_run(json, &state, &bench_ops[i], reps, warmup, &first);
+                    }
+
+                    state_clear(&state);
+                }
+            }
+        }
+    }
+
+    fprintf(json, "\n  ]\n}\n");
+
+    if (json != stdout) {
+        fclose(json);
+    }
+
+    return 0;
+}
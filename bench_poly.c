@@ -0,0 +1,417 @@
+#include "bench_util.h"
+#include "plwe_poly.h"
+#include "prime_table.h"
+#include "util.h"
+
+#include <flint/fmpz_mod.h>
+#include <flint/fmpz_mod_poly.h>
+#include <flint/nmod_poly.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>      // For rdtsc
+#define HAVE_RDTSC
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#define HAVE_PERF
+#endif
+
+#define BENCH_REPS 50           // Timed repetitions of every kernel
+#define BENCH_WARMUP 5          // Untimed repetitions before timing
+#define BENCH_T 2000            // Plaintext modulus for plwe_poly_mod_t
+
+/// Operands of one ring Z_q[x]/(x^n + 1) in every backend
+struct poly_bench {
+    signed long n;
+    fmpz_t q;
+    unsigned long qBits;
+    double std_dev;
+
+    //fmpz_poly, reduced by plwe_poly_pmod
+    struct plwe_poly a;
+    struct plwe_poly b;
+    struct plwe_poly product;   // Unreduced a * b
+    struct plwe_poly result;
+
+    //fmpz_mod_poly, coefficients are always reduced mod q
+    fmpz_mod_ctx_t ctx;
+    fmpz_mod_poly_t mod_a;
+    fmpz_mod_poly_t mod_b;
+    fmpz_mod_poly_t mod_product;
+    fmpz_mod_poly_t mod_result;
+    fmpz_mod_poly_t mod_f;      // x^n + 1
+
+    //nmod_poly, only if q fits a word
+    int word;
+    nmod_poly_t word_a;
+    nmod_poly_t word_b;
+    nmod_poly_t word_product;
+    nmod_poly_t word_result;
+    nmod_poly_t word_f;         // x^n + 1
+};
+
+/// Primitive of a backend, before is untimed and restores the input of an in-place kernel
+struct poly_kernel {
+    const char *backend;
+    const char *name;
+    void (*before)(struct poly_bench *bench);   // NULL if not needed
+    void (*run)(struct poly_bench *bench);
+    int word_only;                              // != 0 if the backend needs q < 2^64
+};
+
+/// Hardware counters of the calling thread, fd < 0 if not available (e.g. perf_event_paranoid or a VM)
+struct perf_counters {
+    int cycles;
+    int cache_misses;
+};
+
+static void fmpz_poly_copy_product(struct poly_bench *bench) {
+    fmpz_poly_set(bench->result.poly, bench->product.poly);
+}
+
+static void fmpz_poly_copy_a(struct poly_bench *bench) {
+    fmpz_poly_set(bench->result.poly, bench->a.poly);
+}
+
+static void run_fmpz_poly_mul(struct poly_bench *bench) {
+    plwe_poly_mul(&bench->result, &bench->a, &bench->b);
+}
+
+static void run_fmpz_poly_pmod(struct poly_bench *bench) {
+    plwe_poly_pmod(&bench->result);
+}
+
+static void run_fmpz_poly_mod_t(struct poly_bench *bench) {
+    plwe_poly_mod_t(&bench->result, BENCH_T);
+}
+
+static void run_rand_poly_uniform(struct poly_bench *bench) {
+    rand_poly_uniform(&bench->result, bench->qBits);
+}
+
+static void run_rand_poly_gauss(struct poly_bench *bench) {
+    rand_poly_gauss(&bench->result, bench->std_dev);
+}
+
+static void run_fmpz_mod_poly_mul(struct poly_bench *bench) {
+    fmpz_mod_poly_mul(bench->mod_result, bench->mod_a, bench->mod_b, bench->ctx);
+}
+
+static void run_fmpz_mod_poly_rem(struct poly_bench *bench) {
+    fmpz_mod_poly_rem(bench->mod_result, bench->mod_product, bench->mod_f, bench->ctx);
+}
+
+static void run_nmod_poly_mul(struct poly_bench *bench) {
+    nmod_poly_mul(bench->word_result, bench->word_a, bench->word_b);
+}
+
+static void run_nmod_poly_rem(struct poly_bench *bench) {
+    nmod_poly_rem(bench->word_result, bench->word_product, bench->word_f);
+}
+
+//pmod of fmpz_mod_poly and nmod_poly is the remainder by x^n + 1, coefficients are already reduced mod q
+static const struct poly_kernel kernels[] = {
+        {"fmpz_poly", "mul", NULL, run_fmpz_poly_mul, 0},
+        {"fmpz_poly", "pmod", fmpz_poly_copy_product, run_fmpz_poly_pmod, 0},
+        {"fmpz_poly", "mod_t", fmpz_poly_copy_a, run_fmpz_poly_mod_t, 0},
+        {"fmpz_poly", "rand_uniform", NULL, run_rand_poly_uniform, 0},
+        {"fmpz_poly", "rand_gauss", NULL, run_rand_poly_gauss, 0},
+        {"fmpz_mod_poly", "mul", NULL, run_fmpz_mod_poly_mul, 0},
+        {"fmpz_mod_poly", "pmod", NULL, run_fmpz_mod_poly_rem, 0},
+        {"nmod_poly", "mul", NULL, run_nmod_poly_mul, 1},
+        {"nmod_poly", "pmod", NULL, run_nmod_poly_rem, 1},
+};
+#define BENCH_KERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+static inline __attribute__((always_inline)) uint64_t tsc(void) {
+#ifdef HAVE_RDTSC
+    _mm_lfence();
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static int perf_open(uint64_t config) {
+#ifdef HAVE_PERF
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void) config;
+    return -1;
+#endif
+}
+
+static void perf_init(struct perf_counters *counters) {
+#ifdef HAVE_PERF
+    counters->cycles = perf_open(PERF_COUNT_HW_CPU_CYCLES);
+    counters->cache_misses = perf_open(PERF_COUNT_HW_CACHE_MISSES);
+#else
+    counters->cycles = -1;
+    counters->cache_misses = -1;
+#endif
+}
+
+static void perf_clear(struct perf_counters *counters) {
+    if (counters->cycles >= 0) {
+        close(counters->cycles);
+    }
+    if (counters->cache_misses >= 0) {
+        close(counters->cache_misses);
+    }
+}
+
+static uint64_t perf_read(int fd) {
+    uint64_t value = 0;
+    if (fd >= 0 && read(fd, &value, sizeof(value)) != sizeof(value)) {
+        value = 0;
+    }
+    return value;
+}
+
+static void poly_bench_init(struct poly_bench *bench, unsigned long n_power, unsigned long qBits) {
+    bench->n = 1L << n_power;
+    fmpz_init(bench->q);
+    if (prime_table_lookup(bench->q, NULL, n_power, qBits) != 0) {
+        generate_prime(bench->q, qBits);
+    }
+    bench->qBits = qBits;
+    bench->std_dev = gen_std_deviation(bench->n);
+
+    plwe_poly_init(&bench->a, bench->q, bench->n);
+    plwe_poly_init(&bench->b, bench->q, bench->n);
+    plwe_poly_init(&bench->product, bench->q, bench->n);
+    plwe_poly_init(&bench->result, bench->q, bench->n);
+
+    //Random operands in [0, 2^qBits), reduced mod q
+    rand_poly_uniform(&bench->a, qBits);
+    rand_poly_uniform(&bench->b, qBits);
+    plwe_poly_pmod(&bench->a);
+    plwe_poly_pmod(&bench->b);
+    plwe_poly_mul(&bench->product, &bench->a, &bench->b);
+
+    //Same operands in the other backends
+    fmpz_mod_ctx_init(bench->ctx, bench->q);
+    fmpz_mod_poly_init(bench->mod_a, bench->ctx);
+    fmpz_mod_poly_init(bench->mod_b, bench->ctx);
+    fmpz_mod_poly_init(bench->mod_product, bench->ctx);
+    fmpz_mod_poly_init(bench->mod_result, bench->ctx);
+    fmpz_mod_poly_init(bench->mod_f, bench->ctx);
+    fmpz_mod_poly_set_fmpz_poly(bench->mod_a, bench->a.poly, bench->ctx);
+    fmpz_mod_poly_set_fmpz_poly(bench->mod_b, bench->b.poly, bench->ctx);
+    fmpz_mod_poly_mul(bench->mod_product, bench->mod_a, bench->mod_b, bench->ctx);
+    fmpz_mod_poly_set_coeff_ui(bench->mod_f, 0, 1, bench->ctx);
+    fmpz_mod_poly_set_coeff_ui(bench->mod_f, bench->n, 1, bench->ctx);
+
+    bench->word = fmpz_sizeinbase(bench->q, 2) <= FLINT_BITS;
+    if (bench->word) {
+        ulong q = fmpz_get_ui(bench->q);
+        nmod_poly_init(bench->word_a, q);
+        nmod_poly_init(bench->word_b, q);
+        nmod_poly_init(bench->word_product, q);
+        nmod_poly_init(bench->word_result, q);
+        nmod_poly_init(bench->word_f, q);
+
+        fmpz_t coeff;
+        fmpz_init(coeff);
+        for (signed long i = 0; i < bench->n; i++) {
+            fmpz_poly_get_coeff_fmpz(coeff, bench->a.poly, i);
+            nmod_poly_set_coeff_ui(bench->word_a, i, fmpz_get_ui(coeff));
+            fmpz_poly_get_coeff_fmpz(coeff, bench->b.poly, i);
+            nmod_poly_set_coeff_ui(bench->word_b, i, fmpz_get_ui(coeff));
+        }
+        fmpz_clear(coeff);
+
+        nmod_poly_mul(bench->word_product, bench->word_a, bench->word_b);
+        nmod_poly_set_coeff_ui(bench->word_f, 0, 1);
+        nmod_poly_set_coeff_ui(bench->word_f, bench->n, 1);
+    }
+}
+
+static void poly_bench_clear(struct poly_bench *bench) {
+    plwe_poly_clear(&bench->a);
+    plwe_poly_clear(&bench->b);
+    plwe_poly_clear(&bench->product);
+    plwe_poly_clear(&bench->result);
+
+    fmpz_mod_poly_clear(bench->mod_a, bench->ctx);
+    fmpz_mod_poly_clear(bench->mod_b, bench->ctx);
+    fmpz_mod_poly_clear(bench->mod_product, bench->ctx);
+    fmpz_mod_poly_clear(bench->mod_result, bench->ctx);
+    fmpz_mod_poly_clear(bench->mod_f, bench->ctx);
+    fmpz_mod_ctx_clear(bench->ctx);
+
+    if (bench->word) {
+        nmod_poly_clear(bench->word_a);
+        nmod_poly_clear(bench->word_b);
+        nmod_poly_clear(bench->word_product);
+        nmod_poly_clear(bench->word_result);
+        nmod_poly_clear(bench->word_f);
+    }
+
+    fmpz_clear(bench->q);
+}
+
+/// Median of samples (sorted in place)
+static double median(double *samples, unsigned long count) {
+    bench_sort(samples, count);
+    return samples[count / 2];
+}
+
+/// Time a kernel and write one JSON result object
+/// Counters that are not available are written as null
+/// @param[out] json Output
+/// @param[in,out] bench Operands
+/// @param[in] kernel Kernel
+/// @param[in] counters Hardware counters
+/// @param[in] reps Timed repetitions
+/// @param[in] warmup Untimed repetitions
+/// @param[in,out] first != 0 if this is the first result (see bench_json_next)
+static void kernel_run(FILE *json, struct poly_bench *bench, const struct poly_kernel *kernel,
+                       const struct perf_counters *counters, unsigned long reps, unsigned long warmup, int *first) {
+    double *ns = malloc(reps * sizeof(double));
+    double *ticks = malloc(reps * sizeof(double));
+    double *cycles = malloc(reps * sizeof(double));
+    double misses = 0;
+
+    for (unsigned long i = 0; i < warmup + reps; i++) {
+        if (kernel->before != NULL) {
+            kernel->before(bench);
+        }
+
+        uint64_t cycles_start = perf_read(counters->cycles);
+        uint64_t misses_start = perf_read(counters->cache_misses);
+        double ns_start = bench_now_ns();
+        uint64_t tsc_start = tsc();
+
+        kernel->run(bench);
+
+        uint64_t tsc_end = tsc();
+        double ns_end = bench_now_ns();
+        uint64_t misses_end = perf_read(counters->cache_misses);
+        uint64_t cycles_end = perf_read(counters->cycles);
+
+        if (i >= warmup) {
+            ns[i - warmup] = ns_end - ns_start;
+            ticks[i - warmup] = (double) (tsc_end - tsc_start);
+            cycles[i - warmup] = (double) (cycles_end - cycles_start);
+            misses += (double) (misses_end - misses_start) / (double) reps;
+        }
+    }
+
+    double ns_median = median(ns, reps), ticks_median = median(ticks, reps), cycles_median = median(cycles, reps);
+
+    fprintf(stderr, "n: %6ld, qBits: %4lu, %-14s %-13s %12.0f ns %14.0f tsc\n", bench->n, bench->qBits,
+            kernel->backend, kernel->name, ns_median, ticks_median);
+
+    bench_json_next(json, first);
+    fprintf(json, "{\"backend\": \"%s\", \"kernel\": \"%s\", \"n\": %ld, \"qBits\": %lu, \"reps\": %lu, "
+                  "\"p50_ns\": %.0f, ", kernel->backend, kernel->name, bench->n, bench->qBits,
+            reps, ns_median);
+
+#ifdef HAVE_RDTSC
+    fprintf(json, "\"p50_tsc\": %.0f, ", ticks_median);
+#else
+    fprintf(json, "\"p50_tsc\": null, ");
+#endif
+
+    if (counters->cycles >= 0) {
+        fprintf(json, "\"p50_cycles\": %.0f, ", cycles_median);
+    }
+    else {
+        fprintf(json, "\"p50_cycles\": null, ");
+    }
+
+    if (counters->cache_misses >= 0) {
+        fprintf(json, "\"mean_cache_misses\": %.1f}", misses);
+    }
+    else {
+        fprintf(json, "\"mean_cache_misses\": null}");
+    }
+
+    free(ns);
+    free(ticks);
+    free(cycles);
+}
+
+int main(int argc, char **argv) {
+    struct bench_values n_powers = {{10, 12, 14}, 3};
+    struct bench_values q_bits = {{60, 128, 256}, 3};
+    unsigned long reps = BENCH_REPS, warmup = BENCH_WARMUP;
+    const char *output = NULL;
+
+    int opt, bad = 0;
+    while ((opt = getopt(argc, argv, "n:q:r:w:o:")) != -1) {
+        switch (opt) {
+            case 'n': bad |= bench_parse_values(&n_powers, optarg); break;
+            case 'q': bad |= bench_parse_values(&q_bits, optarg); break;
+            case 'r': reps = strtoul(optarg, NULL, 10); break;
+            case 'w': warmup = strtoul(optarg, NULL, 10); break;
+            case 'o': output = optarg; break;
+            default: bad = 1;
+        }
+    }
+
+    if (bad || reps == 0) {
+        bench_usage(argv[0], "[-n n_powers] [-q qBits] [-r reps] [-w warmup] [-o output.json]",
+                    "nmod_poly is benchmarked for qBits <= 64 only");
+        return 1;
+    }
+
+    FILE *json = (output == NULL) ? stdout : fopen(output, "w");
+    if (json == NULL) {
+        fprintf(stderr, "Error, can't open %s\n", output);
+        return 1;
+    }
+
+    struct perf_counters counters;
+    perf_init(&counters);
+    if (counters.cycles < 0 || counters.cache_misses < 0) {
+        fprintf(stderr, "Hardware counters not available (see /proc/sys/kernel/perf_event_paranoid)\n");
+    }
+
+    fprintf(json, "{\n  \"compiler\": \"%s\",\n  \"reps\": %lu,\n  \"warmup\": %lu,\n  \"results\": [", __VERSION__,
+            reps, warmup);
+
+    int first = 1;
+    for (unsigned long ni = 0; ni < n_powers.count; ni++) {
+        for (unsigned long qi = 0; qi < q_bits.count; qi++) {
+            struct poly_bench bench;
+            poly_bench_init(&bench, n_powers.values[ni], q_bits.values[qi]);
+
+            for (unsigned long i = 0; i < BENCH_KERNELS; i++) {
+                if (kernels[i].word_only && !bench.word) {
+                    continue;
+                }
+
+                kernel_run(json, &bench, &kernels[i], &counters, reps, warmup, &first);
+            }
+
+            poly_bench_clear(&bench);
+        }
+    }
+
+    fprintf(json, "\n  ]\n}\n");
+
+    if (json != stdout) {
+        fclose(json);
+    }
+    perf_clear(&counters);
+
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "bench_util.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+double bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+void bench_sort(double *samples, unsigned long count) {
+    qsort(samples, count, sizeof(double), compare_double);
+}
+
+int bench_parse_values(struct bench_values *values, const char *arg) {
+    char *end;
+    values->count = 0;
+
+    while (*arg != '\0') {
+        if (values->count == BENCH_MAX_VALUES) {
+            return 1;
+        }
+
+        values->values[values->count++] = strtoul(arg, &end, 10);
+        if (end == arg || (*end != ',' && *end != '\0')) {
+            return 1;
+        }
+
+        arg = (*end == ',') ? end + 1 : end;
+    }
+
+    return values->count == 0;
+}
+
+void bench_usage(const char *name, const char *options, const char *note) {
+    fprintf(stderr, "Usage: %s %s\nLists are comma separated, e.g. -n 10,12,14; %s\n", name, options, note);
+}
+
+void bench_json_next(FILE *json, int *first) {
+    fprintf(json, "%s\n    ", *first ? "" : ",");
+    *first = 0;
+}
@@ -0,0 +1,40 @@
+#ifndef CUSTOM_BENCH_UTIL_H
+#define CUSTOM_BENCH_UTIL_H
+
+#include <stdio.h>
+
+#define BENCH_MAX_VALUES 16     // Maximum amount of values per swept parameter
+
+/// Values of a swept parameter
+struct bench_values {
+    unsigned long values[BENCH_MAX_VALUES];
+    unsigned long count;
+};
+
+/// Monotonic time
+/// @return Time in ns
+double bench_now_ns(void);
+
+/// Sort samples in ascending order
+/// @param[in,out] samples Samples
+/// @param[in] count Amount of samples
+void bench_sort(double *samples, unsigned long count);
+
+/// Parse a comma separated list of values, e.g. "10,12,14"
+/// @param[out] values Values
+/// @param[in] arg List
+/// @return 0 if ok, != 0 otherwise
+int bench_parse_values(struct bench_values *values, const char *arg);
+
+/// Print the usage of a benchmark
+/// @param[in] name Name of the executable
+/// @param[in] options Options, e.g. "[-n n_powers] [-o output.json]"
+/// @param[in] note Remark printed after the explanation of lists
+void bench_usage(const char *name, const char *options, const char *note);
+
+/// Start the next object of the JSON result array, every object but the first is preceded by a comma
+/// @param[out] json Output
+/// @param[in,out] first != 0 before the first object, set to 0
+void bench_json_next(FILE *json, int *first);
+
+#endif //CUSTOM_BENCH_UTIL_H
@@ -1,7 +1,9 @@
 #include "asym.h"
 
+#include "instrument.h"
 #include "key.h"
 #include "message.h"
+#include "plain.h"
 #include "plwe_poly.h"
 #include "util.h"
 
@@ -17,27 +19,22 @@ void keygen(struct key *key, const struct settings * const settings) {
     //e0 <- gauss distribution X
     //b0 = a0 * s + t * e0
 
-    plwe_poly_init(&key->sk, settings->q, settings->n);
+    plwe_poly_small_init(&key->sk, settings->n);
     plwe_poly_init(&key->pk_a, settings->q, settings->n);
     plwe_poly_init(&key->pk_b, settings->q, settings->n);
 
-    struct plwe_poly e0, a0s, te0;
-    plwe_poly_init(&e0, settings->q, settings->n);
-    plwe_poly_init(&a0s, settings->q, settings->n);
-    plwe_poly_init(&te0, settings->q, settings->n);
+    struct plwe_poly_small e0;
+    plwe_poly_small_init(&e0, settings->n);
 
-    rand_poly_gauss(&key->sk, settings->std_dev);
+    rand_poly_small_secret(&key->sk, settings);
     rand_poly_uniform(&key->pk_a, settings->qBits);
-    rand_poly_gauss(&e0, settings->std_dev);
+    rand_poly_small_gauss(&e0, settings->std_dev);
 
-    plwe_poly_mul(&a0s, &key->pk_a, &key->sk);
-    plwe_poly_scalar_mul_ui(&te0, &e0, settings->t);
-    plwe_poly_add(&key->pk_b, &a0s, &te0);
+    plwe_poly_mul_small(&key->pk_b, &key->pk_a, &key->sk);                     //a0 * s
+    plwe_poly_addmul_small_ui(&key->pk_b, &e0, settings->t);                   //a0 * s + t * e0
     plwe_poly_pmod(&key->pk_b);
 
-    plwe_poly_clear(&a0s);
-    plwe_poly_clear(&e0);
-    plwe_poly_clear(&te0);
+    plwe_poly_small_clear(&e0);
 }
 
 void encrypt(struct message *message, const struct plwe_poly *m, const struct key *key) {
@@ -54,28 +51,29 @@ void encrypt(struct message *message, const struct plwe_poly *m, const struct ke
     // e'' <- gauss distribution X'
 
     //Init
-    struct plwe_poly apub, bpub, poly1, poly2;
-    plwe_poly_init(&apub, key->sk.mod, key->sk.n);        //a used for encryption
-    plwe_poly_init(&bpub, key->sk.mod, key->sk.n);        //b used for encryption
-    plwe_poly_init(&poly1, key->sk.mod, key->sk.n);       //working poly 1
-    plwe_poly_init(&poly2, key->sk.mod, key->sk.n);       //working poly 2
+    struct plwe_poly apub, bpub, e_greater;
+    struct plwe_poly_small v, e;
+    plwe_poly_init(&apub, key->settings.q, key->settings.n);        //a used for encryption
+    plwe_poly_init(&bpub, key->settings.q, key->settings.n);        //b used for encryption
+    plwe_poly_init(&e_greater, key->settings.q, key->settings.n);   //e'' exceeds the small coefficients
+    plwe_poly_small_init(&v, key->settings.n);
+    plwe_poly_small_init(&e, key->settings.n);
 
-    plwe_poly_init(&(message->c[0]), key->sk.mod, key->sk.n);
-    plwe_poly_init(&(message->c[1]), key->sk.mod, key->sk.n);
+    plwe_poly_init(&(message->c[0]), key->settings.q, key->settings.n);
+    plwe_poly_init(&(message->c[1]), key->settings.q, key->settings.n);
 
     //Compute
-    rand_poly_gauss(&poly1, key->settings.std_dev);                                //v <- dist
+    rand_poly_small_secret(&v, &key->settings);                                    //v <- secret dist
 
-    plwe_poly_mul(&apub, &key->pk_a, &poly1);                                      //apub = a0*v
-    plwe_poly_mul(&bpub, &key->pk_b, &poly1);                                      //bpub = b0*v
+    plwe_poly_mul_small(&apub, &key->pk_a, &v);                                    //apub = a0*v
+    plwe_poly_mul_small(&bpub, &key->pk_b, &v);                                    //bpub = b0*v
 
-    rand_poly_gauss(&poly1, key->settings.std_dev);                                //e' <- dist
-    rand_poly_gauss(&poly2, key->settings.greater_std_dev);                        //e'' <- greater dist
-    plwe_poly_scalar_mul_ui(&poly1, &poly1, key->settings.t);                      //t*e'
-    plwe_poly_scalar_mul_ui(&poly2, &poly2, key->settings.t);                      //t*e''
+    rand_poly_small_gauss(&e, key->settings.std_dev);                              //e' <- dist
+    plwe_poly_addmul_small_ui(&apub, &e, key->settings.t);                         //apub = a0*v + t*e'
 
-    plwe_poly_add(&apub, &apub, &poly1);                                           //apub = a0*v + t*e'
-    plwe_poly_add(&bpub, &bpub, &poly2);                                           //bpub = b0*v + t*e''
+    rand_poly_gauss(&e_greater, key->settings.greater_std_dev);                    //e'' <- greater dist
+    plwe_poly_scalar_mul_ui(&e_greater, &e_greater, key->settings.t);              //t*e''
+    plwe_poly_add(&bpub, &bpub, &e_greater);                                       //bpub = b0*v + t*e''
 
     plwe_poly_add(&(message->c[0]), &bpub, m);                               //c0 = bpub + m
     plwe_poly_scalar_mul_si(&(message->c[1]), &apub, -1);              //c1 = -apub
@@ -88,8 +86,9 @@ void encrypt(struct message *message, const struct plwe_poly *m, const struct ke
     //Cleanup
     plwe_poly_clear(&apub);
     plwe_poly_clear(&bpub);
-    plwe_poly_clear(&poly1);
-    plwe_poly_clear(&poly2);
+    plwe_poly_clear(&e_greater);
+    plwe_poly_small_clear(&v);
+    plwe_poly_small_clear(&e);
 }
 
 void encrypt_sym(struct message *message, const struct plwe_poly *m, const struct key *key) {
@@ -106,21 +105,20 @@ void encrypt_sym(struct message *message, const struct plwe_poly *m, const struc
     //c1 = -a
 
     //Init
-    struct plwe_poly poly1, poly2;
-    plwe_poly_init(&poly1, key->sk.mod, key->sk.n);       //working poly 1
-    plwe_poly_init(&poly2, key->sk.mod, key->sk.n);       //working poly 2
-    plwe_poly_init(&(message->c[0]), key->sk.mod, key->sk.n);
-    plwe_poly_init(&(message->c[1]), key->sk.mod, key->sk.n);
+    struct plwe_poly poly1;
+    struct plwe_poly_small e;
+    plwe_poly_init(&poly1, key->settings.q, key->settings.n);       //working poly 1
+    plwe_poly_small_init(&e, key->settings.n);
+    plwe_poly_init(&(message->c[0]), key->settings.q, key->settings.n);
+    plwe_poly_init(&(message->c[1]), key->settings.q, key->settings.n);
 
     //Compute
-    rand_poly_gauss(&poly1, key->settings.std_dev);                                //e <- dist
-    plwe_poly_scalar_mul_ui(&poly1, &poly1, key->settings.t);                      //t*e
-
-    rand_poly_uniform(&poly2, key->settings.qBits);                                //a = <- R_q
-    plwe_poly_scalar_mul_si(&(message->c[1]), &poly2, -1);            //c1 = -a
+    rand_poly_uniform(&poly1, key->settings.qBits);                                //a = <- R_q
+    plwe_poly_scalar_mul_si(&(message->c[1]), &poly1, -1);            //c1 = -a
 
-    plwe_poly_mul(&poly2, &key->sk, &poly2);                                      //a*s
-    plwe_poly_add(&poly1, &poly1, &poly2);                                        //a*s + t*e
+    plwe_poly_mul_small(&poly1, &poly1, &key->sk);                                //a*s
+    rand_poly_small_gauss(&e, key->settings.std_dev);                              //e <- dist
+    plwe_poly_addmul_small_ui(&poly1, &e, key->settings.t);                        //a*s + t*e
     plwe_poly_add(&(message->c[0]), &poly1, m);                             //c0 = a*s + t*e + m
 
     plwe_poly_pmod(&(message->c[0]));
@@ -130,43 +128,102 @@ void encrypt_sym(struct message *message, const struct plwe_poly *m, const struc
 
     //Cleanup
     plwe_poly_clear(&poly1);
-    plwe_poly_clear(&poly2);
+    plwe_poly_small_clear(&e);
 }
 
-void eval_add(struct message *result, struct message *message1, struct message *message2){
+void encrypt_sym_seeded(struct message *message, const struct plwe_poly *m, const struct key *key) {
+    if ((message->cIndex + 1) >= message->max_len){
+        printf("Can't add more elements to the message. Maximum max_len (%ld) reached.\n"
+               "Doing nothing.", message->max_len);
+        return;
+    }
+
+    // Seeded Symmetrical Encryption
+    // seed <- random
+    // a = expand(seed) <- R_q
+    //c0 = as + te + m
+    //c1 = -a is only stored as seed and expanded by message_expand
+
+    //Init
+    struct plwe_poly poly1;
+    struct plwe_poly_small e;
+    plwe_poly_init(&poly1, key->settings.q, key->settings.n);       //working poly 1
+    plwe_poly_small_init(&e, key->settings.n);
+    plwe_poly_init(&(message->c[0]), key->settings.q, key->settings.n);
+    plwe_poly_init(&(message->c[1]), key->settings.q, key->settings.n);
+
+    //Compute
+    urandom_seed(message->seed);
+    rand_poly_uniform_seeded(&poly1, key->settings.qBits, message->seed);          //a = expand(seed)
+
+    plwe_poly_mul_small(&poly1, &poly1, &key->sk);                                //a*s
+    rand_poly_small_gauss(&e, key->settings.std_dev);                              //e <- dist
+    plwe_poly_addmul_small_ui(&poly1, &e, key->settings.t);                        //a*s + t*e
+    plwe_poly_add(&(message->c[0]), &poly1, m);                             //c0 = a*s + t*e + m
+
+    plwe_poly_pmod(&(message->c[0]));
+
+    message->cIndex += 2;
+    message->seeded = 1;
+
+    //Cleanup
+    plwe_poly_clear(&poly1);
+    plwe_poly_small_clear(&e);
+}
+
+void eval_add(struct message *result, const struct message *message1, const struct message *message2){
     //c(add) = c + c' = ((b + b'), -(a + a')) = (( a + a' )s + 2(e + e') + (m + m'), -(a + a'))
     //c0=b0v+te''+m c1=-a
 
-    //Do padding for smaller polynomial
-    unsigned int polynum1 = message1->cIndex;
-    unsigned int polynum2 = message2->cIndex;
-    unsigned int polynum_max = MAX(polynum1, polynum2);
+    unsigned long polynum1 = message1->cIndex;
+    unsigned long polynum2 = message2->cIndex;
+    unsigned long polynum_max = MAX(polynum1, polynum2);
 
-    if (polynum1 < polynum2){
-        unsigned int diff = polynum2 - polynum1;
-        for (int i = 0; i < diff; i++){
-            plwe_poly_init(&(message1->c[polynum_max - diff]), result->c->mod, result->c->n);
-        }
-    }
-    else if (polynum1 > polynum2){
-        unsigned int diff = polynum1 - polynum2;
-        for (int i = 0; i < diff; i++){
-            plwe_poly_init(&(message2->c[polynum_max - diff]), result->c->mod, result->c->n);
-        }
+    if (polynum_max > result->max_len){
+        printf("Error, result message too small to hold result!\n");
+        return;
     }
-    //else nothing to do
 
-    //Do computation
+    INSTRUMENT_START(timer_eval_add);
+
+    //Seeded inputs are expanded into temporary copies, the inputs are only read
+    struct message temp1, temp2;
+    message1 = message_expanded(&temp1, message1);
+    message2 = message_expanded(&temp2, message2);
+
+    //Do computation in new allocated memory, the smaller ciphertext is padded with zero polynomials implicitly
     struct plwe_poly *ptr = malloc(result->max_len * sizeof(struct plwe_poly));
 
-    for (int i = 0; i < polynum_max; i++){
+    for (unsigned long i = 0; i < polynum_max; i++){
         plwe_poly_init(&ptr[i], message1->c[0].mod, message1->c[0].n);
-        fmpz_poly_add(ptr[i].poly, message1->c[i].poly, message2->c[i].poly);
+
+        if (i < polynum1 && i < polynum2) {
+            fmpz_poly_add(ptr[i].poly, message1->c[i].poly, message2->c[i].poly);
+        }
+        else if (i < polynum1) {
+            fmpz_poly_set(ptr[i].poly, message1->c[i].poly);
+        }
+        else {
+            fmpz_poly_set(ptr[i].poly, message2->c[i].poly);
+        }
+
         plwe_poly_pmod(&ptr[i]);
     }
 
+    //Replace the elements of result, it might be one of the inputs
+    for (unsigned long i = 0; i < result->cIndex; i++){
+        plwe_poly_clear(&result->c[i]);
+    }
     free(result->c);
+
     result->c = ptr;
+    result->cIndex = polynum_max;
+    result->seeded = 0;
+
+    message_expanded_clear(&temp1, message1);
+    message_expanded_clear(&temp2, message2);
+
+    INSTRUMENT_STOP(timer_eval_add);
 }
 
 void eval_mul(struct message *result, const struct message *message1, const struct message *message2){
@@ -187,6 +244,14 @@ void eval_mul(struct message *result, const struct message *message1, const stru
         return;
     }
 
+    INSTRUMENT_START(timer_eval_mul);
+
+    //Seeded inputs are expanded into temporary copies, the inputs are only read
+    struct message temp1, temp2;
+    message1 = message_expanded(&temp1, message1);
+    message2 = message_expanded(&temp2, message2);
+    INSTRUMENT_COUNT(counter_ring_mul, message1->cIndex * message2->cIndex);
+
     //Do computations in new allocated memory and replace existing memory to prevent overwrites of data
     struct plwe_poly *ptr = malloc(result->max_len * sizeof(struct plwe_poly));
 
@@ -210,48 +275,108 @@ void eval_mul(struct message *result, const struct message *message1, const stru
         plwe_poly_pmod(&ptr[i]);
     }
 
+    //Replace the elements of result, it might be one of the inputs
+    for (unsigned long i = 0; i < result->cIndex; i++){
+        plwe_poly_clear(&result->c[i]);
+    }
     free(result->c);
 
     result->c = ptr;
-    result->max_len = message1->max_len;
     result->cIndex = len;
+    result->seeded = 0;
+
+    message_expanded_clear(&temp1, message1);
+    message_expanded_clear(&temp2, message2);
+
+    INSTRUMENT_STOP(timer_eval_mul);
 }
 
 void eval_add_plain(struct message *result, const struct message *message, const struct plwe_poly *plain) {
+    INSTRUMENT_START(timer_eval_add_plain);
+
+    //Only c0 is read and written, c1 of a seeded ciphertext stays a seed
     plwe_poly_add(&result->c[0], &message->c[0], plain);
+    plwe_poly_pmod(&result->c[0]);
+
+    INSTRUMENT_STOP(timer_eval_add_plain);
 }
 
 void eval_mul_plain(struct message *result, const struct message *message, const struct plwe_poly *plain) {
-    for (int i = 0; i < message->cIndex; i++){
-        plwe_poly_mul(&result->c[i], &message->c[i], plain);
+    INSTRUMENT_START(timer_eval_mul_plain);
+
+    //All elements of result are written, a seeded input is read from a temporary copy
+    struct message temp;
+    message_expand(result);
+    message = message_expanded(&temp, message);
+
+    //Plaintexts of small integers have only a few non-zero coefficients, shift and scale instead of a full product
+    if (plwe_poly_nnz(plain) <= SPARSE_THRESHOLD) {
+        struct plwe_poly_sparse sparse;
+        plwe_poly_sparse_init(&sparse, plain);
+
+        for (int i = 0; i < message->cIndex; i++){
+            plwe_poly_mul_sparse(&result->c[i], &message->c[i], &sparse);
+            plwe_poly_pmod(&result->c[i]);
+        }
+
+        plwe_poly_sparse_clear(&sparse);
+    }
+    else {
+        for (int i = 0; i < message->cIndex; i++){
+            plwe_poly_mul(&result->c[i], &message->c[i], plain);
+            plwe_poly_pmod(&result->c[i]);
+        }
     }
-}
 
-void decrypt(struct plwe_poly *m, const struct message *message, const struct key *key) {
-    //Decryption works by calculating c_0 + c_1*s + c2*s^2 + c3*s^3 + ... + cl*s^l for l=cIndex
-    struct plwe_poly powered_key, product;
-    plwe_poly_init(&powered_key, key->settings.q, key->settings.n);
-    plwe_poly_init(&product, key->settings.q, key->settings.n);
+    message_expanded_clear(&temp, message);
 
-    plwe_poly_set(&powered_key, &key->sk);
+    INSTRUMENT_STOP(timer_eval_mul_plain);
+}
+
+void eval_add_plain_enc(struct message *result, const struct message *message, const struct plain *plain) {
+    eval_add_plain(result, message, &plain->poly);
+}
 
-    //Set c0
-    plwe_poly_set(m, &(message->c[0]));
+void eval_mul_plain_enc(struct message *result, const struct message *message, struct plain *plain) {
+    INSTRUMENT_START(timer_eval_mul_plain);
 
-    //Set c1
-    plwe_poly_mul(&product, &(message->c[1]), &(key->sk));  //Calculate c1*s
-    plwe_poly_add(m, m, &product);//Add to previous value
+    //All elements of result are written, a seeded input is read from a temporary copy
+    struct message temp;
+    message_expand(result);
+    message = message_expanded(&temp, message);
 
-    //Set c2-cl
-    for (int i = 2; i < message->cIndex; i++){
-        plwe_poly_mul(&powered_key, &powered_key, &(key->sk));  //Calculate s^i
-        plwe_poly_mul(&product, &message->c[i], &powered_key);  //Calculate ci*s^i
-        plwe_poly_add(m, m, &product);  //Add to previous value
+    for (int i = 0; i < message->cIndex; i++){
+        plain_mul(&result->c[i], &message->c[i], plain);
     }
 
-    plwe_poly_clear(&powered_key);
-    plwe_poly_clear(&product);
+    message_expanded_clear(&temp, message);
+
+    INSTRUMENT_STOP(timer_eval_mul_plain);
+}
+
+void decrypt(struct plwe_poly *m, const struct message *message, const struct key *key) {
+    //Decryption works by calculating c_0 + c_1*s + c2*s^2 + c3*s^3 + ... + cl*s^l for l=cIndex
+    //Evaluate in Horner form c_0 + s*(c_1 + s*(c_2 + ... + s*c_l)) and reduce after every step,
+    //this requires l ring multiplications and keeps the degree and coefficient size bounded
+    //The small key does not depend on q, modulus switched ciphertexts need no special treatment
+    INSTRUMENT_START(timer_decrypt);
+
+    struct message temp;
+    message = message_expanded(&temp, message);
+
+    //Set cl
+    plwe_poly_set(m, &(message->c[message->cIndex - 1]));
+
+    //Set c(l-1)-c0
+    for (signed long i = (signed long) message->cIndex - 2; i >= 0; i--) {
+        plwe_poly_mul_small(m, m, &key->sk);  //Multiply previous value with s
+        plwe_poly_add(m, m, &(message->c[i]));  //Add ci
+        plwe_poly_pmod(m);
+    }
 
-    plwe_poly_pmod(m);
     plwe_poly_mod_t(m, key->settings.t);
+
+    message_expanded_clear(&temp, message);
+
+    INSTRUMENT_STOP(timer_decrypt);
 }
@@ -6,6 +6,7 @@ struct key;         /// defined in key.h
 struct message;     /// defined in message.h
 struct settings;    /// defined in util.h
 struct plwe_poly;   /// defined in plwe_poly.h
+struct plain;       /// defined in plain.h
 
 /// Generate keys
 /// @param[out] key Empty Key
@@ -24,11 +25,17 @@ void encrypt(struct message *message, const struct plwe_poly *m, const struct ke
 /// @param[in] key Key for encryption (only sk is used)
 void encrypt_sym(struct message *message, const struct plwe_poly *m, const struct key *key);
 
+/// Encrypt a plaintext symmetrically, c1 is stored as seed (half-size ciphertext) until message_expand expands it
+/// @param[out] message Empty Ciphertext
+/// @param[in] m Plaintext
+/// @param[in] key Key for encryption (only sk is used)
+void encrypt_sym_seeded(struct message *message, const struct plwe_poly *m, const struct key *key);
+
 /// Add two ciphertexts
 /// @param[out] result Result of the operation
 /// @param[in] message1 Ciphertext 1
 /// @param[in] message2 Ciphertext 2
-void eval_add(struct message *result, struct message *message1, struct message *message2);
+void eval_add(struct message *result, const struct message *message1, const struct message *message2);
 
 /// Multiply two ciphertexts
 /// @param[out] result Result of the operation
@@ -48,6 +55,18 @@ void eval_add_plain(struct message *result, const struct message *message, const
 /// @param[in] plain Plaintext
 void eval_mul_plain(struct message *result, const struct message *message, const struct plwe_poly *plain);
 
+/// Add an encoded plaintext to a ciphertext
+/// @param[out] result Result of the operation
+/// @param[in] message Ciphertext
+/// @param[in] plain Encoded plaintext
+void eval_add_plain_enc(struct message *result, const struct message *message, const struct plain *plain);
+
+/// Multiply an encoded plaintext with a ciphertext, uses the form of the encoded plaintext
+/// @param[out] result Result of the operation
+/// @param[in] message Ciphertext
+/// @param[in] plain Encoded plaintext
+void eval_mul_plain_enc(struct message *result, const struct message *message, struct plain *plain);
+
 /// Decrypt a ciphertext
 /// @param[out] m Empty Plaintext
 /// @param[in] message Ciphertext
@@ -1,8 +1,29 @@
 #include "binary_tree.h"
 
+#include "asym.h"
+#include "cost.h"
+#include "future.h"
+#include "message.h"
+#include "primes.h"
+#include "threading.h"
 #include "util.h"
 
 #include <flint/fmpz_poly.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Traversal
+#define VISITED_INITIAL_CAPACITY 64     // Initial size of the visited set, doubled at a load of 1/2
+
+/// Nodes visited by one pass over a tree or DAG (open addressing), every pass owns its set
+/// Passes over distinct trees may therefore run concurrently, the nodes need no preparation
+struct visited_set {
+    const struct node **table;      // NULL for empty slots
+    unsigned long capacity;
+    unsigned long count;
+};
 
 //Static declarations
 /// Algorithm 1: Generating_SHE_Parameters
@@ -12,19 +33,37 @@
 /// @param[in] m Array containing the maximum column values
 /// @param[in] m_len Length of m
 /// @param[in] security_level Required security level
-/// @param[in] improvements_factor Maximum amount of loop iterations to find a better q
-static void generate_parameters(struct settings *settings, const int m[], int m_len, struct node *root, int security_level, int improvements_factor);
+/// @param[in] improvements_factor 0 for the smallest prime q, otherwise q = 1 mod 2n (transform friendly)
+/// @param[in] encoding Encoding used for the leaves
+/// @param[in] model Cost model, NULL for the smallest secure n
+static void generate_parameters(struct settings *settings, const int m[], int m_len, struct node *root, int security_level, int improvements_factor, enum encoding_mode encoding, const struct cost_model *model);
 
 /// Algorithm 2: Estimate_ResultingPoly_fromArithmeticTree
 /// @param[out] node Root node
 /// @param[in] n Polynomial degree n
 /// @param[in] b Basis b
-static void estimate_poly(struct node *node, signed long n, signed int b);
+/// @param[in] encoding Encoding used for the leaves
+/// @param[in,out] visited Nodes of this pass, shared nodes are estimated once
+static void estimate_poly(struct node *node, signed long n, signed int b, enum encoding_mode encoding, struct visited_set *visited);
 
 /// Algorithm 3: Compute_MultDepth_fromArithmeticTree
 /// @param[in] node Root node
+/// @param[in,out] visited Nodes of this pass, shared nodes are computed once
 /// @return Arithmetic depth D
-static int compute_d(struct node *node);
+static int compute_d(struct node *node, struct visited_set *visited);
+
+/// Predict the evaluation time of a tree or DAG including encryption of the leaves
+/// @param[in] node Root node
+/// @param[in] model Cost model
+/// @param[in] n Polynomial degree n
+/// @param[in] qBits Bits of q
+/// @param[in] T Base of the evaluation key, 0 if products are not relinearized
+/// @param[in,out] visited Nodes of this pass, shared nodes are evaluated once
+/// @return Predicted time in ns without the decryption
+static double estimate_latency(struct node *node, const struct cost_model *model, signed long n, unsigned long qBits, int T, struct visited_set *visited);
+
+/// Predict the end-to-end time of a tree or DAG (encryption, evaluation and decryption)
+static double tree_latency(struct node *root, const struct cost_model *model, signed long n, unsigned long qBits, int T);
 
 /// Compute log_b(v) (effectively how large degree b must be to hold v using base b)
 static inline __attribute__((always_inline)) int int_log(int base, int value) {
@@ -46,15 +85,132 @@ static inline __attribute__((always_inline)) unsigned long min_ulong(unsigned lo
     return (x < y) ? x : y;
 }
 
-static void generate_parameters(struct settings *settings, const int m[], int m_len, struct node *root, int security_level, int improvements_factor) {
-    //Variables
-    int current_security_level;         //Actual security level of the implementation
+static unsigned long ptr_hash(const void *ptr, unsigned long capacity) {
+    uintptr_t x = (uintptr_t) ptr;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdUL;
+    x ^= x >> 33;
+
+    return (unsigned long) x & (capacity - 1);
+}
+
+static void visited_init(struct visited_set *visited) {
+    visited->capacity = VISITED_INITIAL_CAPACITY;
+    visited->count = 0;
+    visited->table = calloc(visited->capacity, sizeof(struct node *));
+}
+
+/// Forget all nodes for the next pass, the table keeps its size
+static void visited_reset(struct visited_set *visited) {
+    memset(visited->table, 0, visited->capacity * sizeof(struct node *));
+    visited->count = 0;
+}
+
+static void visited_clear(struct visited_set *visited) {
+    free(visited->table);
+    visited->table = NULL;
+    visited->capacity = 0;
+    visited->count = 0;
+}
+
+/// Add a node to the visited set
+/// @return 1 if the node was visited before in this pass, 0 otherwise
+static int visited_insert(struct visited_set *visited, const struct node *node) {
+    unsigned long i = ptr_hash(node, visited->capacity);
+
+    while (visited->table[i] != NULL) {
+        if (visited->table[i] == node) {
+            return 1;
+        }
+        i = (i + 1) & (visited->capacity - 1);
+    }
+
+    visited->table[i] = node;
+    visited->count++;
+
+    if (2 * visited->count > visited->capacity) {
+        //Grow, rehash all nodes
+        unsigned long capacity = 2 * visited->capacity;
+        const struct node **table = calloc(capacity, sizeof(struct node *));
+
+        for (unsigned long j = 0; j < visited->capacity; j++) {
+            if (visited->table[j] != NULL) {
+                unsigned long k = ptr_hash(visited->table[j], capacity);
+                while (table[k] != NULL) {
+                    k = (k + 1) & (capacity - 1);
+                }
+                table[k] = visited->table[j];
+            }
+        }
+
+        free(visited->table);
+        visited->table = table;
+        visited->capacity = capacity;
+    }
+
+    return 0;
+}
+
+#define PARAM_B_RANGE 4             // Bases above the smallest usable one considered by the cost model search
+#define PARAM_N_RANGE 4             // Degrees up to PARAM_N_RANGE times the smallest secure one considered by the cost model search
+#define PARAM_STD_DEVIATION 8.0     // Standard deviation used for the noise bound
+
+//Bases of the evaluation key considered by the cost model search, 0 for no relinearization
+static const int relin_bases[] = {0, 2, 4, 16, 62};
+#define RELIN_BASES 5
+
+/// Compute the noise bound 2 * l_inf * (t * std_dev * n^1.5)^(D + 2) + relin_noise, q must be larger
+static void noise_bound(mpz_t bound, signed long n, unsigned long t, int D, unsigned long inf_norm, double relin_noise) {
+    mpf_t res, inp;
+    mpf_init(res);
+    mpf_init(inp);
 
+    mpf_set_ui(res, t);                             //res = t
+    mpf_set_d(inp, PARAM_STD_DEVIATION);            //inp = std_deviation
+    mpf_mul(res, res, inp);                         //res = t * std_deviation
+    mpf_set_d(inp, pow((double) n, 1.5 ));          //inp = n^1.5
+    mpf_mul(res, res, inp);                         //res = t * std_deviation * n^1.5
+    mpf_pow_ui(res, res, D + 2);                    //res = (t * std_deviation * n^1.5)^(D+2)
+    mpf_mul_ui(res, res, inf_norm);                 //res = l_inf * (t * std_deviation * n^1.5)^(D+2)
+    mpf_mul_ui(res, res, 2);                        //res = 2 * l_inf * (t * std_deviation * n^1.5)^(D+2)
+    mpf_set_d(inp, relin_noise);
+    mpf_add(res, res, inp);                         //res = 2 * l_inf * (t * std_deviation * n^1.5)^(D+2) + relin_noise
+    mpz_set_f(bound, res);
+
+    mpf_clear(res);
+    mpf_clear(inp);
+}
+
+/// Find a prime q > bound, with q = 1 mod 2n unless improvements_factor is 0
+static void find_q(mpz_t q, const mpz_t bound, signed long n, int improvements_factor) {
+    if (improvements_factor == 0) {
+        mpz_nextprime(q, bound);                    //q (prime) > 2 * l_inf * (t * std_deviation * n^1.5)^(D+2)
+        return;
+    }
+
+    //Only candidates k * 2n + 1 are tested, the prime is at most a few bits above the smallest one
+    mpz_t start;
+    mpz_init(start);
+    mpz_add_ui(start, bound, 1);
+
+    prime_search_congruent(q, start, 2 * n);
+
+    mpz_clear(start);
+}
+
+/// Compute security level = (1.8 * (2n + l)^2)/(n * qBits) - 140
+static int compute_security_level(signed long n, unsigned long qBits, unsigned long inf_norm) {
+    double l = (double) n_sizeinbase(inf_norm, 2);
+    return (int) (1.8 * (2.0 * n + l) * (2.0 * n + l) / ((double) n * (double) qBits) - 140);
+}
+
+static void generate_parameters(struct settings *settings, const int m[], int m_len, struct node *root, int security_level, int improvements_factor, enum encoding_mode encoding, const struct cost_model *model) {
+    //Variables
     signed long n = 1;                  //1, not sqrt(2) because n = 2n in each iteration, not n=n^2
+    signed long n_secure = 0;           //Smallest n reaching the security level
     unsigned long t;                    //Message space t
     int b;                              //Base b
-    int D;                              //Max ciphertext length D
-    double std_deviation = 8;           //Standard deviation = 8
+    int D;                              //Max ciphertext length D without relinearization
 
     int max_m = 0;
 
@@ -65,105 +221,131 @@ static void generate_parameters(struct settings *settings, const int m[], int m_
         }
     }
 
-    mpz_t q, two_n, one, tmp;
-    mpz_init(q);
-    mpz_init(two_n);
-    mpz_init(tmp);
-    mpz_init_set_si(one, 1);
+    //Compute D
+    //Every pass over the DAG starts with an empty visited set
+    struct visited_set visited;
+    visited_init(&visited);
 
-    mpf_t res, inp;
-    mpf_init(res);
-    mpf_init(inp);
+    D = 2 + compute_d(root, &visited);  //Basic length of 2 + number of multiplications
+
+    //Best parameters, without a cost model the first secure ones
+    signed long best_n = 0;
+    unsigned long best_t = 0;
+    int best_b = 0, best_T = 0;
+    double best_latency = 0;
+
+    mpz_t q, q_plain, bound, best_q;
+    mpz_init(q);
+    mpz_init(q_plain);
+    mpz_init(bound);
+    mpz_init(best_q);
 
     do {
         n = n << 1;  // n = 2n
 
-        //Compute b
+        //Compute b, start with the smallest b for which the result fits
         b = max_int(ceil(pow(max_m, 1.0/(double) n)), 2) - 1;  //Start value
 
         do {
             b += 1;
-            estimate_poly(root, n, b);
+            visited_reset(&visited);
+            estimate_poly(root, n, b, encoding, &visited);
         } while (root->degree >= n);
 
-        //Set t to next power of 2 above root->inf_norm
-        t = 1 << (1 + (int) log2((int) root->inf_norm + 1));
+        //Larger b shrink the degree but grow t (and therefore q)
+        int b_max = (model == NULL) ? b : b + PARAM_B_RANGE;
 
-        //Compute D
-        D = 2 + compute_d(root);  //Basic length of 2 + number of multiplications
+        for (; b <= b_max; b++) {
+            visited_reset(&visited);
+            estimate_poly(root, n, b, encoding, &visited);
 
-        //Compute q > 2 * l_inf * (t * std_dev * n^1,5)^D
-        mpf_set_ui(res, t);                             //res = t
-        mpf_set_d(inp, std_deviation);                  //inp = std_deviation
-        mpf_mul(res, res, inp);                         //res = t * std_deviation
-        mpf_set_d(inp, pow((double) n, 1.5 ));       //inp = n^1.5
-        mpf_mul(res, res, inp);                         //res = t * std_deviation * n^1.5
-        mpf_pow_ui(res, res, D + 2);                    //res = (t * std_deviation * n^1.5)^(D+2)
-        mpf_mul_ui(res, res, root->inf_norm);           //res = l_inf * (t * std_deviation * n^1.5)^(D+2)
-        mpf_mul_ui(res, res, 2);                        //res = 2 * l_inf * (t * std_deviation * n^1.5)^(D+2)
-        mpz_set_f(q, res);                              //q = 2 * l_inf * (t * std_deviation * n^1.5)^(D+2)
+            //Set t to next power of 2 above root->inf_norm
+            t = 1 << (1 + (int) log2((int) root->inf_norm + 1));
 
-        mpz_nextprime(q, q);                            //q (prime) > 2 * l_inf * (t * std_deviation * n^1.5)^(D+2)
+            //Compute q > 2 * l_inf * (t * std_dev * n^1,5)^D
+            noise_bound(bound, n, t, D, root->inf_norm, 0);
+            find_q(q_plain, bound, n, improvements_factor);
 
-        //Additional improvements for q
-        mpz_set_si(two_n, n);                           //two_n = n
-        mpz_mul_2exp(two_n, two_n, 1);                  //two_n = 2n
+            for (int i = 0; i < ((model == NULL) ? 1 : RELIN_BASES); i++) {
+                int T = relin_bases[i];
 
-        int counter = 0;
-        mpz_set(tmp,q);
+                if (T != 0 && D == 2) {
+                    //No products
+                    continue;
+                }
 
-        while ((counter < improvements_factor || improvements_factor == -1) && mpz_congruent_p(one, tmp, two_n) == 0) {
-            mpz_nextprime(tmp, tmp);
-            counter += 1;
-        }
+                mpz_set(q, q_plain);
 
-        if (mpz_congruent_p(one, tmp, two_n) != 0) {
-            //q fulfills the requirement
-            mpz_set(q, tmp);
-        }
+                if (T != 0) {
+                    //Every relinearization adds at most (l + 1) * T * n * std_dev * t to the noise of a product
+                    double digits = ceil((double) mpz_sizeinbase(q_plain, 2) / log2((double) T)) + 1;
+                    noise_bound(bound, n, t, D, root->inf_norm, 2.0 * (D - 2) * digits * T * (double) n * PARAM_STD_DEVIATION * (double) t);
+
+                    if (mpz_cmp(q_plain, bound) <= 0) {
+                        find_q(q, bound, n, improvements_factor);
+                    }
+                }
+
+                if (compute_security_level(n, mpz_sizeinbase(q, 2), root->inf_norm) < security_level) {
+                    continue;
+                }
 
-        //Compute security level = (1.8 * (2n + l)^2)/(n * qBits) - 140
-        mpf_set_z(res, two_n);                                                //res = 2n
-        mpf_set_si(inp, n_sizeinbase(root->inf_norm, 2));               //inp = l
-        mpf_add(res, res, inp);                                               //res = 2n+l
-        mpf_mul(res,res,res);                                                 //res = (2n + l)^2
-        mpf_set_d(inp, 1.8);                                                  //inp = 1.8
-        mpf_mul(res, res, inp);                                               //res = 1.8 * (2n + l)^2
-        mpz_set_si(tmp, mpz_sizeinbase(q, 2));                                //tmp = qBits
-        mpz_mul_si(tmp, tmp, n);                                              //tmp = n * qBits
-        mpf_set_z(inp, tmp);                                                  //inp = n * qBits
-        mpf_div(res, res, inp);                                               //res = 1.8 * (2n + l)^2 / (n * qBits)
-        mpf_sub_ui(res, res, 140);                                            //res = 1.8 * (2n + l)^2 / (n * qBits) - 140
+                double latency = (model == NULL) ? 0 : tree_latency(root, model, n, mpz_sizeinbase(q, 2), T);
 
-        current_security_level = mpf_get_si(res);
-    } while (current_security_level < security_level);
+                if (best_n == 0 || latency < best_latency) {
+                    best_n = n;
+                    best_t = t;
+                    best_b = b;
+                    best_T = T;
+                    best_latency = latency;
+                    mpz_set(best_q, q);
+                }
+            }
+        }
+
+        if (best_n != 0 && n_secure == 0) {
+            n_secure = n;
+        }
+    } while (best_n == 0 || (model != NULL && n < PARAM_N_RANGE * n_secure));
 
     fmpz_t qout;
     fmpz_init(qout);
-    fmpz_set_mpz(qout, q);
+    fmpz_set_mpz(qout, best_q);
 
-    settings_init(settings, n_sizeinbase(n, 2), qout, t, b, D);
+    //With relinearization every product of two 2 element ciphertexts is shrunk immediately
+    settings_init(settings, n_sizeinbase(best_n, 2) - 1, qout, best_t, best_b, (best_T != 0) ? 3 : D);
+    settings->encoding = encoding;
+    settings->T = best_T;
 
     fmpz_clear(qout);
 
-    mpf_clear(res);
-    mpf_clear(inp);
-
-    mpz_clear(one);
-    mpz_clear(tmp);
-    mpz_clear(two_n);
+    mpz_clear(q);
+    mpz_clear(q_plain);
+    mpz_clear(bound);
+    mpz_clear(best_q);
+    visited_clear(&visited);
 }
 
-static void estimate_poly(struct node *node ,signed long n, signed int b) {
+static void estimate_poly(struct node *node ,signed long n, signed int b, enum encoding_mode encoding, struct visited_set *visited) {
     if(node == NULL) {
         // Parent node is a leaf
         return;
     }
 
-    estimate_poly(node->left_node, n, b);
-    estimate_poly(node->right_node, n, b);
+    if (visited_insert(visited, node)) {
+        // Shared node, already estimated in this pass
+        return;
+    }
+
+    estimate_poly(node->left_node, n, b, encoding, visited);
+    estimate_poly(node->right_node, n, b, encoding, visited);
 
-    if ((node->left_node == NULL) && (node->right_node == NULL)) {
+    if ((node->left_node == NULL) && (node->right_node == NULL) && encoding == encoding_balanced) {
+        // This node is a leaf with balanced digits in (-b/2, b/2], which might need one more digit
+        node->degree = int_log(b, 2 * node->M);
+        node->inf_norm = min_ulong(node->M, b / 2);
+    }
+    else if ((node->left_node == NULL) && (node->right_node == NULL)) {
         // This node is a leaf
         node->degree = int_log(b, node->M);
 
@@ -187,25 +369,591 @@ static void estimate_poly(struct node *node ,signed long n, signed int b) {
     }
 }
 
-static int compute_d(struct node *node) {
+static int compute_d(struct node *node, struct visited_set *visited) {
+    if (visited_insert(visited, node)) {
+        // Shared node, already computed in this pass
+        return node->d;
+    }
+
+    node->d = 0;  // 0, if it's a leaf
+
     if(node->type == plus) {
-        return max_int(compute_d(node->left_node), compute_d(node->right_node));
+        node->d = max_int(compute_d(node->left_node, visited), compute_d(node->right_node, visited));
+    }
+    else if(node->type == multiply) {
+        node->d = 1 + compute_d(node->left_node, visited) + compute_d(node->right_node, visited);
+    }
+
+    return node->d;
+}
+
+static double estimate_latency(struct node *node, const struct cost_model *model, signed long n, unsigned long qBits, int T, struct visited_set *visited) {
+    if (visited_insert(visited, node)) {
+        // Shared node, already evaluated
+        return 0;
     }
 
-    if(node->type == multiply) {
-        return 1 + compute_d(node->left_node) + compute_d(node->right_node);
+    if (node->left_node == NULL && node->right_node == NULL) {
+        // Leaf, fresh ciphertext (b v + t e + m, a v)
+        node->d = 2;
+        return 2 * (cost_mul(model, n, qBits) + cost_add(model, n, qBits));
     }
 
-    return 0;  // return 0, it's a leaf
+    double latency = estimate_latency(node->left_node, model, n, qBits, T, visited) +
+                     estimate_latency(node->right_node, model, n, qBits, T, visited);
+    int len1 = node->left_node->d;
+    int len2 = node->right_node->d;
+
+    if (node->type == plus) {
+        node->d = max_int(len1, len2);
+        latency += node->d * cost_add(model, n, qBits);
+    }
+    else {
+        // All len1 * len2 products are accumulated
+        node->d = len1 + len2 - 1;
+        latency += len1 * len2 * (cost_mul(model, n, qBits) + cost_add(model, n, qBits));
+
+        if (T != 0 && node->d == 3) {
+            node->d = 2;
+            latency += cost_relin(model, n, qBits, T);
+        }
+    }
+
+    return latency;
+}
+
+static double tree_latency(struct node *root, const struct cost_model *model, signed long n, unsigned long qBits, int T) {
+    struct visited_set visited;
+    visited_init(&visited);
+
+    double latency = estimate_latency(root, model, n, qBits, T, &visited);
+
+    visited_clear(&visited);
+
+    // Decryption, Horner scheme with one product per element
+    return latency + (root->d - 1) * (cost_mul(model, n, qBits) + cost_add(model, n, qBits));
 }
 
-void create_tree_and_generate_params(struct settings *settings, void (*treefunc)(struct node *func_node, int func_rows, const int func_m[]), int rows, const int m[], int m_len,  int security_level, int improvements_factor) {
+double predict_latency(const struct cost_model *model, struct node *root, const struct settings *settings) {
+    return tree_latency(root, model, settings->n, settings->qBits, settings->T);
+}
+
+void create_tree_and_generate_params(struct settings *settings, void (*treefunc)(struct node *func_node, int func_rows, const int func_m[]), int rows, const int m[], int m_len,  int security_level, int improvements_factor, enum encoding_mode encoding, const struct cost_model *model) {
     //Init root
     struct node root;
     root.inf_norm = 0;
     root.degree = 0;
     root.type = plus;
+    root.message = NULL;
 
     treefunc(&root, rows, m);
-    generate_parameters(settings, m, m_len, &root, security_level, improvements_factor);
+
+    //Estimate on the DAG, identical subtrees are estimated once
+    struct dag dag;
+    dag_init(&dag);
+
+    generate_parameters(settings, m, m_len, dag_from_tree(&dag, &root), security_level, improvements_factor, encoding, model);
+
+    dag_clear(&dag);
+}
+
+//DAG
+#define DAG_INITIAL_CAPACITY 64     // Initial size of the hash table, doubled at a load of 1/2
+
+static inline __attribute__((always_inline)) int is_leaf(const struct node *node) {
+    return (node->left_node == NULL) && (node->right_node == NULL);
+}
+
+static unsigned long dag_hash(enum node_type type, int M, const struct message *message,
+                              const struct node *left_node, const struct node *right_node) {
+    //FNV-1a over the identifying fields
+    uintptr_t fields[5] = {(uintptr_t) type, (uintptr_t) (unsigned int) M, (uintptr_t) message,
+                           (uintptr_t) left_node, (uintptr_t) right_node};
+    unsigned long hash = 14695981039346656037UL;
+
+    for (int i = 0; i < 5; i++) {
+        for (unsigned int byte = 0; byte < sizeof(uintptr_t); byte++) {
+            hash ^= (fields[i] >> (8 * byte)) & 0xff;
+            hash *= 1099511628211UL;
+        }
+    }
+
+    return hash;
+}
+
+static int dag_equal(const struct node *node, enum node_type type, int M, const struct message *message,
+                     const struct node *left_node, const struct node *right_node) {
+    return node->type == type && node->M == M && node->message == message &&
+           node->left_node == left_node && node->right_node == right_node;
+}
+
+static void dag_insert(struct node **table, unsigned long capacity, struct node *node) {
+    unsigned long i = dag_hash(node->type, node->M, node->message, node->left_node, node->right_node) & (capacity - 1);
+
+    while (table[i] != NULL) {
+        i = (i + 1) & (capacity - 1);
+    }
+
+    table[i] = node;
+}
+
+/// Find or create a node
+static struct node * dag_node(struct dag *dag, enum node_type type, int M, struct message *message,
+                              struct node *left_node, struct node *right_node) {
+    unsigned long i = dag_hash(type, M, message, left_node, right_node) & (dag->capacity - 1);
+
+    while (dag->table[i] != NULL) {
+        if (dag_equal(dag->table[i], type, M, message, left_node, right_node)) {
+            return dag->table[i];
+        }
+        i = (i + 1) & (dag->capacity - 1);
+    }
+
+    struct node *node = malloc(sizeof(struct node));
+    node->inf_norm = 0;
+    node->degree = 0;
+    node->type = type;
+    node->M = M;
+    node->message = message;
+    node->d = 0;
+    node->left_node = left_node;
+    node->right_node = right_node;
+
+    dag->table[i] = node;
+    dag->count++;
+
+    if (2 * dag->count > dag->capacity) {
+        //Grow, rehash all nodes
+        unsigned long capacity = 2 * dag->capacity;
+        struct node **table = calloc(capacity, sizeof(struct node *));
+
+        for (unsigned long j = 0; j < dag->capacity; j++) {
+            if (dag->table[j] != NULL) {
+                dag_insert(table, capacity, dag->table[j]);
+            }
+        }
+
+        free(dag->table);
+        dag->table = table;
+        dag->capacity = capacity;
+    }
+
+    return node;
+}
+
+void dag_init(struct dag *dag) {
+    dag->capacity = DAG_INITIAL_CAPACITY;
+    dag->count = 0;
+    dag->table = calloc(dag->capacity, sizeof(struct node *));
+}
+
+void dag_clear(struct dag *dag) {
+    for (unsigned long i = 0; i < dag->capacity; i++) {
+        free(dag->table[i]);
+    }
+
+    free(dag->table);
+    dag->table = NULL;
+    dag->capacity = 0;
+    dag->count = 0;
+}
+
+struct node * dag_value(struct dag *dag, int M, struct message *message) {
+    return dag_node(dag, value, M, message, NULL, NULL);
+}
+
+struct node * dag_constant(struct dag *dag, int M) {
+    return dag_node(dag, constant, M, NULL, NULL, NULL);
+}
+
+struct node * dag_operation(struct dag *dag, enum node_type type, struct node *left_node, struct node *right_node) {
+    //Both operations are commutative, order the operands canonically
+    if ((uintptr_t) left_node > (uintptr_t) right_node) {
+        struct node *tmp = left_node;
+        left_node = right_node;
+        right_node = tmp;
+    }
+
+    return dag_node(dag, type, 0, NULL, left_node, right_node);
+}
+
+struct node * dag_from_tree(struct dag *dag, const struct node *root) {
+    if (is_leaf(root)) {
+        return dag_node(dag, root->type, root->M, (root->type == constant) ? NULL : root->message, NULL, NULL);
+    }
+
+    struct node *left_node = dag_from_tree(dag, root->left_node);
+    struct node *right_node = dag_from_tree(dag, root->right_node);
+
+    return dag_operation(dag, root->type, left_node, right_node);
+}
+
+unsigned long tree_depth(const struct node *node) {
+    if (node->left_node == NULL || node->right_node == NULL) {
+        return 0;  // return 0, it's a leaf
+    }
+
+    unsigned long depth = max_ulong(tree_depth(node->left_node), tree_depth(node->right_node));
+
+    return (node->type == multiply) ? depth + 1 : depth;
+}
+
+/// Count the operands of the chain of operations of type below node
+static unsigned long count_chain(const struct node *node, enum node_type type) {
+    if (node->left_node == NULL || node->right_node == NULL || node->type != type) {
+        return 1;
+    }
+
+    return count_chain(node->left_node, type) + count_chain(node->right_node, type);
+}
+
+/// Collect the operands and the operation nodes of the chain of operations of type below node
+static void collect_chain(struct node *node, enum node_type type, struct node **operands, unsigned long *n_operands,
+                          struct node **operations, unsigned long *n_operations) {
+    if (node->left_node == NULL || node->right_node == NULL || node->type != type) {
+        operands[(*n_operands)++] = node;
+        return;
+    }
+
+    operations[(*n_operations)++] = node;
+    collect_chain(node->left_node, type, operands, n_operands, operations, n_operations);
+    collect_chain(node->right_node, type, operands, n_operands, operations, n_operations);
+}
+
+/// Rebalance the tree below node
+/// @param[in,out] node Root of the subtree
+/// @return Multiplicative depth of the subtree
+static unsigned long rebalance_node(struct node *node) {
+    if (node->left_node == NULL || node->right_node == NULL) {
+        return 0;
+    }
+
+    enum node_type type = node->type;
+    unsigned long count = count_chain(node, type);
+
+    //A chain of count operands consists of count - 1 operation nodes, node is the first one
+    struct node **operands = malloc(count * sizeof(struct node *));
+    struct node **operations = malloc((count - 1) * sizeof(struct node *));
+    unsigned long *depths = malloc(count * sizeof(unsigned long));
+    unsigned long n_operands = 0;
+    unsigned long n_operations = 0;
+
+    collect_chain(node, type, operands, &n_operands, operations, &n_operations);
+
+    for (unsigned long i = 0; i < count; i++) {
+        depths[i] = rebalance_node(operands[i]);
+    }
+
+    //Combine the two shallowest operands until one is left, node is reused last to stay the root
+    while (n_operands > 1) {
+        unsigned long a = 0;
+        unsigned long b = 1;
+
+        if (depths[b] < depths[a]) {
+            a = 1;
+            b = 0;
+        }
+
+        for (unsigned long i = 2; i < n_operands; i++) {
+            if (depths[i] < depths[a]) {
+                b = a;
+                a = i;
+            }
+            else if (depths[i] < depths[b]) {
+                b = i;
+            }
+        }
+
+        struct node *operation = operations[--n_operations];
+        operation->type = type;
+        operation->left_node = operands[a];
+        operation->right_node = operands[b];
+
+        unsigned long depth = max_ulong(depths[a], depths[b]) + ((type == multiply) ? 1 : 0);
+
+        //Replace a with the combination, fill b with the last operand
+        operands[a] = operation;
+        depths[a] = depth;
+        operands[b] = operands[n_operands - 1];
+        depths[b] = depths[n_operands - 1];
+        n_operands--;
+    }
+
+    unsigned long depth = depths[0];
+
+    free(operands);
+    free(operations);
+    free(depths);
+
+    return depth;
+}
+
+void tree_rebalance(struct node *root) {
+    rebalance_node(root);
+}
+
+
+//Evaluation
+#define EVAL_MAP_INITIAL_CAPACITY 64    // Initial size of the node -> slot map, doubled at a load of 1/2
+
+struct tree_eval_context {
+    const struct settings *settings;
+    struct thread_pool *pool;
+    struct key_eval *key_eval;
+};
+
+/// Evaluation state of a distinct node
+struct eval_slot {
+    struct node *node;
+    struct message message;         // Intermediate ciphertext of an operation node
+    struct message *out;            // Where the node is evaluated to (message, result or the leaf ciphertext)
+    struct future *future;          // NULL for leaves and without a pool
+    atomic_ulong consumers;         // Parents which did not use out yet
+    struct eval_slot *left;         // NULL for leaves
+    struct eval_slot *right;
+    struct tree_eval_context *context;
+};
+
+/// Slots of all distinct nodes in post-order and a node -> slot map (open addressing)
+struct eval_plan {
+    struct eval_slot **slots;
+    unsigned long count;
+    unsigned long slots_capacity;
+    struct eval_slot **map;
+    unsigned long map_capacity;
+};
+
+static struct eval_slot * plan_find(const struct eval_plan *plan, const struct node *node) {
+    unsigned long i = ptr_hash(node, plan->map_capacity);
+
+    while (plan->map[i] != NULL) {
+        if (plan->map[i]->node == node) {
+            return plan->map[i];
+        }
+        i = (i + 1) & (plan->map_capacity - 1);
+    }
+
+    return NULL;
+}
+
+static void plan_insert(struct eval_plan *plan, struct eval_slot *slot) {
+    if (plan->count == plan->slots_capacity) {
+        plan->slots_capacity *= 2;
+        plan->slots = realloc(plan->slots, plan->slots_capacity * sizeof(struct eval_slot *));
+    }
+    plan->slots[plan->count++] = slot;
+
+    if (2 * plan->count > plan->map_capacity) {
+        //Grow, rehash all slots
+        free(plan->map);
+        plan->map_capacity *= 2;
+        plan->map = calloc(plan->map_capacity, sizeof(struct eval_slot *));
+
+        for (unsigned long j = 0; j < plan->count - 1; j++) {
+            unsigned long i = ptr_hash(plan->slots[j]->node, plan->map_capacity);
+            while (plan->map[i] != NULL) {
+                i = (i + 1) & (plan->map_capacity - 1);
+            }
+            plan->map[i] = plan->slots[j];
+        }
+    }
+
+    unsigned long i = ptr_hash(slot->node, plan->map_capacity);
+    while (plan->map[i] != NULL) {
+        i = (i + 1) & (plan->map_capacity - 1);
+    }
+    plan->map[i] = slot;
+}
+
+/// Create the slots of all distinct nodes below node in post-order, check the nodes and expand seeded leaves
+/// (they are shared by concurrent operations afterwards)
+/// @param[in,out] plan Evaluation plan
+/// @param[in] node Node
+/// @param[in,out] context Evaluation context
+/// @return Slot of node, NULL on error
+static struct eval_slot * plan_node(struct eval_plan *plan, struct node *node, struct tree_eval_context *context) {
+    struct eval_slot *slot = plan_find(plan, node);
+
+    if (slot != NULL) {
+        //Shared node, one more parent
+        atomic_fetch_add(&slot->consumers, 1);
+        return slot;
+    }
+
+    struct eval_slot *left = NULL;
+    struct eval_slot *right = NULL;
+
+    if (is_leaf(node)) {
+        if (node->type == constant) {
+            printf("Error, constant nodes are only supported by compiled tapes!\n");
+            return NULL;
+        }
+
+        if (node->message == NULL) {
+            printf("Error, value node without ciphertext!\n");
+            return NULL;
+        }
+
+        message_expand(node->message);
+    }
+    else {
+        if (node->left_node == NULL || node->right_node == NULL) {
+            printf("Error, operation node with a single operand!\n");
+            return NULL;
+        }
+
+        left = plan_node(plan, node->left_node, context);
+        right = (left == NULL) ? NULL : plan_node(plan, node->right_node, context);
+        if (right == NULL) {
+            return NULL;
+        }
+    }
+
+    slot = malloc(sizeof(struct eval_slot));
+    slot->node = node;
+    slot->out = is_leaf(node) ? node->message : &slot->message;
+    slot->future = NULL;
+    atomic_init(&slot->consumers, 1);
+    slot->left = left;
+    slot->right = right;
+    slot->context = context;
+
+    plan_insert(plan, slot);
+
+    return slot;
+}
+
+/// Hand over the result of a child to one of its parents, the intermediate is cleared after its last use
+/// @param[in,out] slot Slot of the child
+static void release_operand(struct eval_slot *slot) {
+    if (atomic_fetch_sub(&slot->consumers, 1) == 1 && slot->left != NULL) {
+        message_clear(slot->out);
+    }
+}
+
+/// Evaluate an operation node, the operands are available; runs as future operation
+/// @param[in,out] arg Slot of the node
+/// @return future_ok or future_invalid_input if a ciphertext exceeds its maximum length
+static int evaluate_node(void *arg) {
+    struct eval_slot *slot = arg;
+    struct tree_eval_context *context = slot->context;
+    struct message *result = slot->out;
+    struct message *operand1 = slot->left->out;
+    struct message *operand2 = slot->right->out;
+    int status = future_ok;
+
+    unsigned long len1 = operand1->cIndex;
+    unsigned long len2 = operand2->cIndex;
+
+    if (slot->node->type == multiply && len1 + len2 - 1 <= result->max_len) {
+        eval_mul_parallel(context->pool, result, operand1, operand2);
+
+        //Shrink products of two 2 element ciphertexts immediately, later operations stay cheap
+        if (context->key_eval != NULL && result->cIndex == 3) {
+            message_relinearize(result, context->key_eval);
+        }
+    }
+    else if (slot->node->type == plus && max_ulong(len1, len2) <= result->max_len) {
+        eval_add(result, operand1, operand2);
+    }
+    else {
+        printf("Error, ciphertext exceeds the maximum length of %ld elements!\n", result->max_len);
+        status = future_invalid_input;
+    }
+
+    //The operands are consumed
+    release_operand(slot->left);
+    release_operand(slot->right);
+
+    return status;
+}
+
+int evaluate_tree(struct message *result, struct node *root, const struct settings *settings, struct thread_pool *pool, struct key_eval *key_eval) {
+    struct tree_eval_context context;
+    context.settings = settings;
+    context.pool = pool;
+    context.key_eval = key_eval;
+
+    struct eval_plan plan;
+    plan.count = 0;
+    plan.slots_capacity = EVAL_MAP_INITIAL_CAPACITY;
+    plan.slots = malloc(plan.slots_capacity * sizeof(struct eval_slot *));
+    plan.map_capacity = EVAL_MAP_INITIAL_CAPACITY;
+    plan.map = calloc(plan.map_capacity, sizeof(struct eval_slot *));
+
+    struct eval_slot *root_slot = plan_node(&plan, root, &context);
+    int status = (root_slot == NULL) ? future_invalid_input : future_ok;
+
+    if (root_slot != NULL && root_slot->left == NULL) {
+        //Single value node
+        message_set(result, root_slot->out);
+    }
+    else if (root_slot != NULL) {
+        //The root is evaluated directly into result, all other operation nodes into their intermediates
+        for (unsigned long i = 0; i < plan.count; i++) {
+            struct eval_slot *slot = plan.slots[i];
+
+            if (slot->left != NULL && slot != root_slot) {
+                message_init(&slot->message, settings);
+            }
+        }
+        root_slot->out = result;
+
+        //Post-order, the operands of every node precede it
+        for (unsigned long i = 0; i < plan.count && (pool != NULL || status == future_ok); i++) {
+            struct eval_slot *slot = plan.slots[i];
+
+            if (slot->left == NULL) {
+                continue;
+            }
+
+            if (pool == NULL) {
+                status = evaluate_node(slot);
+                continue;
+            }
+
+            struct future *deps[2];
+            unsigned long n_deps = 0;
+
+            if (slot->left->future != NULL) {
+                deps[n_deps++] = slot->left->future;
+            }
+            if (slot->right->future != NULL && slot->right != slot->left) {
+                deps[n_deps++] = slot->right->future;
+            }
+
+            slot->future = future_submit(pool, evaluate_node, slot, deps, n_deps);
+        }
+
+        if (pool != NULL) {
+            status = future_wait(root_slot->future);
+
+            //The root finished (or failed), wait for the operations still running before freeing their slots
+            for (unsigned long i = 0; i < plan.count; i++) {
+                if (plan.slots[i]->future != NULL) {
+                    future_wait(plan.slots[i]->future);
+                }
+            }
+        }
+
+        //Intermediates which were not consumed because an operation failed or was not run
+        for (unsigned long i = 0; i < plan.count; i++) {
+            struct eval_slot *slot = plan.slots[i];
+
+            if (slot->left != NULL && slot != root_slot && atomic_load(&slot->consumers) > 0) {
+                message_clear(&slot->message);
+            }
+        }
+    }
+
+    for (unsigned long i = 0; i < plan.count; i++) {
+        if (plan.slots[i]->future != NULL) {
+            future_release(plan.slots[i]->future);
+        }
+        free(plan.slots[i]);
+    }
+    free(plan.slots);
+    free(plan.map);
+
+    return (status == future_ok) ? 0 : 1;
 }
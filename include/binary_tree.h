@@ -1,13 +1,19 @@
 #ifndef CUSTOM_BINARY_TREE_H
 #define CUSTOM_BINARY_TREE_H
 
+#include "util.h"
+
 //Forward declarations
-struct settings;    /// defined in util.h
+struct cost_model;  /// defined in cost.h
+struct key_eval;    /// defined in key.h
+struct message;     /// defined in message.h
+struct thread_pool; /// defined in threading.h
 
 enum node_type {
     plus = 1,
     multiply = 2,
     value = 3,
+    constant = 4,   // Plaintext leaf, M is its value (supported by compiled tapes, see tape.h)
 };
 
 struct node {
@@ -15,11 +21,21 @@ struct node {
     unsigned long degree;
     enum node_type type; // + or * or value
     int M;
+    struct message *message;    // Encrypted value of a value node (used by evaluate_tree), NULL otherwise
+    int d;                      // Result of compute_d or ciphertext length of the latency estimation (valid during a pass)
 
     struct node *left_node;
     struct node *right_node;
 };
 
+/// Hash-consed node store, structurally identical subexpressions exist only once (DAG)
+/// Operands of plus and multiply are ordered canonically, i.e. x * y and y * x share one node
+struct dag {
+    struct node **table;        // Open addressing, NULL for empty slots
+    unsigned long capacity;
+    unsigned long count;
+};
+
 /// Create binary tree and compute parameters
 /// @param[out] settings Settings to save the parameters
 /// @param[in] treefunc Function for tree generation of the form func(struct node *func_node, int func_rows, const int func_m[])
@@ -27,7 +43,75 @@ struct node {
 /// @param[in] m Array containing the maximum column values
 /// @param[in] m_len Length of m
 /// @param[in] security_level Required security level
-/// @param[in] improvements_factor Maximum amount of loop iterations to find a better q
-void create_tree_and_generate_params(struct settings *settings, void (*treefunc)(struct node *func_node, int func_rows, const int func_m[]), int rows, const int m[], int m_len,  int security_level, int improvements_factor);
+/// @param[in] improvements_factor 0 for the smallest prime q, otherwise q = 1 mod 2n (transform friendly)
+/// @param[in] encoding Encoding used for the leaves, balanced digits reduce the norm estimation and therefore t and q
+/// @param[in] model Cost model, if not NULL the parameters (n, b, t, q, T) with the lowest predicted latency are chosen,
+/// otherwise the smallest secure n; settings->T is the base for key_init_eval (0 if products are not relinearized)
+void create_tree_and_generate_params(struct settings *settings, void (*treefunc)(struct node *func_node, int func_rows, const int func_m[]), int rows, const int m[], int m_len,  int security_level, int improvements_factor, enum encoding_mode encoding, const struct cost_model *model);
+
+/// Predict the time to encrypt the leaves, evaluate and decrypt a tree or DAG
+/// @param[in] model Cost model
+/// @param[in] root Root node
+/// @param[in] settings Settings, products are relinearized if settings->T != 0
+/// @return Predicted time in ns
+double predict_latency(const struct cost_model *model, struct node *root, const struct settings *settings);
+
+/// Initialize an empty DAG
+/// @param[out] dag DAG
+void dag_init(struct dag *dag);
+
+/// Free all nodes of a DAG
+/// @param[in,out] dag DAG
+void dag_clear(struct dag *dag);
+
+/// Get the value node for M and a ciphertext, the node is created on first use
+/// @param[in,out] dag DAG
+/// @param[in] M Maximum value of the leaf
+/// @param[in] message Encrypted value, may be NULL if the DAG is only used for parameter generation
+/// @return Shared node
+struct node * dag_value(struct dag *dag, int M, struct message *message);
+
+/// Get the constant node for a plaintext value, the node is created on first use
+/// @param[in,out] dag DAG
+/// @param[in] M Value of the constant
+/// @return Shared node
+struct node * dag_constant(struct dag *dag, int M);
+
+/// Get the operation node for two operands, the node is created on first use
+/// @param[in,out] dag DAG
+/// @param[in] type plus or multiply
+/// @param[in] left_node Operand of the DAG
+/// @param[in] right_node Operand of the DAG
+/// @return Shared node
+struct node * dag_operation(struct dag *dag, enum node_type type, struct node *left_node, struct node *right_node);
+
+/// Import a tree (e.g. generated by a treefunc), identical subtrees are merged; the tree is not modified
+/// @param[in,out] dag DAG
+/// @param[in] root Root node of the tree
+/// @return Root node in the DAG
+struct node * dag_from_tree(struct dag *dag, const struct node *root);
+
+/// Compute the multiplicative depth of a tree (maximum amount of multiplications on a path from a leaf to the root)
+/// @param[in] node Root node
+/// @return Multiplicative depth
+unsigned long tree_depth(const struct node *node);
+
+/// Rebalance chains of the same operation (plus or multiply are associative and commutative) to minimize the
+/// multiplicative depth, the operands of a chain are combined in the order of their depth (Huffman)
+/// The nodes are rearranged in place, root stays the root of the tree; rebalance before building a DAG, shared
+/// nodes would be rearranged for every parent
+/// @param[in,out] root Root node
+void tree_rebalance(struct node *root);
+
+/// Evaluate an arithmetic tree or DAG homomorphically
+/// Every distinct node is evaluated once, independent nodes in parallel; intermediate ciphertexts are cleared as soon as
+/// all of their parents used them
+/// @param[out] result Ciphertext initialized with message_init, receives the encrypted result of the root
+/// @param[in] root Root node, every value node must hold a ciphertext in message (the leaves are not modified)
+/// @param[in] settings Settings used to initialize the intermediate ciphertexts
+/// @param[in,out] pool Thread pool, NULL to evaluate in the calling thread
+/// @param[in] key_eval Evaluation key, if not NULL every product is relinearized back to 2 elements
+/// @return 0 on success, 1 if a value node has no ciphertext or a ciphertext exceeds its maximum length
+int evaluate_tree(struct message *result, struct node *root, const struct settings *settings, struct thread_pool *pool, struct key_eval *key_eval);
 
 #endif //CUSTOM_BINARY_TREE_H
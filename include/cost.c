@@ -0,0 +1,197 @@
+#include "cost.h"
+
+#include "key.h"
+#include "message.h"
+#include "plwe_poly.h"
+#include "util.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define COST_MIN_NS 20000000.0      // Minimum duration of a benchmark (20 ms), the repetitions are doubled until reached
+#define COST_RELIN_T 16             // Base of the evaluation key used for calibration
+
+//(n, qBits) of the benchmarks
+static const signed long cost_points_n[] = {256, 256, 1024, 1024, 4096};
+static const unsigned long cost_points_bits[] = {60, 250, 60, 250, 120};
+#define COST_POINTS 5
+#define COST_RELIN_POINTS 2         // The relinearization is benchmarked for the first points only
+
+struct cost_bench {
+    struct plwe_poly a;
+    struct plwe_poly b;
+    struct plwe_poly result;
+    struct message product;     // 3 element ciphertext, copied before every relinearization
+    struct message message;
+    struct key_eval key_eval;
+};
+
+static inline __attribute__((always_inline)) double limbs(unsigned long qBits) {
+    return (double) ((qBits + 63) / 64);
+}
+
+static void bench_mul(struct cost_bench *bench) {
+    plwe_poly_mul(&bench->result, &bench->a, &bench->b);
+    plwe_poly_pmod(&bench->result);
+}
+
+static void bench_add(struct cost_bench *bench) {
+    plwe_poly_add(&bench->result, &bench->a, &bench->b);
+    plwe_poly_pmod(&bench->result);
+}
+
+static void bench_relin(struct cost_bench *bench) {
+    message_set(&bench->message, &bench->product);
+    message_relinearize(&bench->message, &bench->key_eval);
+}
+
+/// Time an operation
+/// @param[in] op Operation
+/// @param[in,out] bench Operands
+/// @return Average time of one operation in ns
+static double benchmark(void (*op)(struct cost_bench *bench), struct cost_bench *bench) {
+    struct timespec start, end;
+    double elapsed;
+    unsigned long reps = 1;
+
+    op(bench);  //Warm up
+
+    while (1) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (unsigned long i = 0; i < reps; i++) {
+            op(bench);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        elapsed = (double) (end.tv_sec - start.tv_sec) * 1e9 + (double) (end.tv_nsec - start.tv_nsec);
+        if (elapsed >= COST_MIN_NS) {
+            return elapsed / (double) reps;
+        }
+
+        reps *= 2;
+    }
+}
+
+static double mul_feature(signed long n, unsigned long qBits) {
+    double size = (double) n * limbs(qBits);
+    return size * log2(size);
+}
+
+static double add_feature(signed long n, unsigned long qBits) {
+    return (double) n * limbs(qBits);
+}
+
+void cost_model_init(struct cost_model *model) {
+    model->mul = 4.0;
+    model->add = 10.0;
+    model->relin = 1.2;
+}
+
+void cost_model_calibrate(struct cost_model *model) {
+    //Least squares fit of time = coefficient * feature, i.e. sum(feature * time) / sum(feature^2)
+    double mul_xy = 0, mul_xx = 0, add_xy = 0, add_xx = 0;
+    double relin[COST_RELIN_POINTS];
+    double mul_time[COST_POINTS], add_time[COST_POINTS];
+
+    for (int i = 0; i < COST_POINTS; i++) {
+        signed long n = cost_points_n[i];
+        unsigned long qBits = cost_points_bits[i];
+
+        fmpz_t q;
+        fmpz_init(q);
+        generate_prime(q, qBits);
+
+        struct cost_bench bench;
+        plwe_poly_init(&bench.a, q, n);
+        plwe_poly_init(&bench.b, q, n);
+        plwe_poly_init(&bench.result, q, n);
+        rand_poly_uniform(&bench.a, qBits);
+        rand_poly_uniform(&bench.b, qBits);
+
+        mul_time[i] = benchmark(bench_mul, &bench);
+        add_time[i] = benchmark(bench_add, &bench);
+
+        mul_xy += mul_feature(n, qBits) * mul_time[i];
+        mul_xx += mul_feature(n, qBits) * mul_feature(n, qBits);
+        add_xy += add_feature(n, qBits) * add_time[i];
+        add_xx += add_feature(n, qBits) * add_feature(n, qBits);
+
+        if (i < COST_RELIN_POINTS) {
+            //Random evaluation keys and ciphertext, the time does not depend on the values
+            struct settings settings;
+            settings_init(&settings, n_sizeinbase(n, 2) - 1, q, 2, 2, 3);
+
+            bench.key_eval.T = COST_RELIN_T;
+            bench.key_eval.l = fmpz_sizeinbase(q, COST_RELIN_T);
+            bench.key_eval.ek0 = malloc((bench.key_eval.l + 1) * sizeof(struct plwe_poly));
+            bench.key_eval.ek1 = malloc((bench.key_eval.l + 1) * sizeof(struct plwe_poly));
+
+            for (unsigned long j = 0; j <= bench.key_eval.l; j++) {
+                plwe_poly_init(&bench.key_eval.ek0[j], q, n);
+                plwe_poly_init(&bench.key_eval.ek1[j], q, n);
+                rand_poly_uniform(&bench.key_eval.ek0[j], qBits);
+                rand_poly_uniform(&bench.key_eval.ek1[j], qBits);
+            }
+
+            message_init(&bench.product, &settings);
+            message_init(&bench.message, &settings);
+            for (unsigned long j = 0; j < 3; j++) {
+                plwe_poly_init(&bench.product.c[j], q, n);
+                rand_poly_uniform(&bench.product.c[j], qBits);
+            }
+            bench.product.cIndex = 3;
+
+            double ops = (double) (bench.key_eval.l + 1) * 2 * (mul_time[i] + add_time[i]);
+            relin[i] = benchmark(bench_relin, &bench) / ops;
+
+            message_clear(&bench.product);
+            message_clear(&bench.message);
+            for (unsigned long j = 0; j <= bench.key_eval.l; j++) {
+                plwe_poly_clear(&bench.key_eval.ek0[j]);
+                plwe_poly_clear(&bench.key_eval.ek1[j]);
+            }
+            key_clear_eval(&bench.key_eval);
+            fmpz_clear(settings.q);
+        }
+
+        plwe_poly_clear(&bench.a);
+        plwe_poly_clear(&bench.b);
+        plwe_poly_clear(&bench.result);
+        fmpz_clear(q);
+    }
+
+    model->mul = mul_xy / mul_xx;
+    model->add = add_xy / add_xx;
+
+    model->relin = 0;
+    for (int i = 0; i < COST_RELIN_POINTS; i++) {
+        model->relin += relin[i] / COST_RELIN_POINTS;
+    }
+}
+
+void cost_model_print(const struct cost_model *model) {
+    printf("Cost model: mul %.3f ns, add %.3f ns, relin %.3f\n", model->mul, model->add, model->relin);
+
+    for (int i = 0; i < COST_POINTS; i++) {
+        printf("n: %ld, qBits: %ld, mul: %.0f ns, add: %.0f ns, relin (T = %d): %.0f ns\n", cost_points_n[i],
+               cost_points_bits[i], cost_mul(model, cost_points_n[i], cost_points_bits[i]),
+               cost_add(model, cost_points_n[i], cost_points_bits[i]), COST_RELIN_T,
+               cost_relin(model, cost_points_n[i], cost_points_bits[i], COST_RELIN_T));
+    }
+}
+
+double cost_mul(const struct cost_model *model, signed long n, unsigned long qBits) {
+    return model->mul * mul_feature(n, qBits);
+}
+
+double cost_add(const struct cost_model *model, signed long n, unsigned long qBits) {
+    return model->add * add_feature(n, qBits);
+}
+
+double cost_relin(const struct cost_model *model, signed long n, unsigned long qBits, int T) {
+    //l + 1 digits of q in base T, every digit is multiplied with both evaluation keys
+    double digits = ceil((double) qBits / log2((double) T)) + 1;
+    return model->relin * digits * 2 * (cost_mul(model, n, qBits) + cost_add(model, n, qBits));
+}
@@ -0,0 +1,47 @@
+#ifndef CUSTOM_COST_H
+#define CUSTOM_COST_H
+
+/// Runtime model of the polynomial operations, calibrated by micro-benchmarks on the host
+/// Costs are predicted in ns from the degree n and the bit-size of q (limbs = ceil(qBits / 64))
+struct cost_model {
+    double mul;             // ns per n * limbs * log2(n * limbs) of a product (fmpz_poly_mul and reduction)
+    double add;             // ns per n * limbs of an addition (including the reduction)
+    double relin;           // Ratio of a relinearization to its (l + 1) * 2 products and additions
+};
+
+/// Initialize a cost model with default values (measured on a x86-64 desktop), use cost_model_calibrate for the host
+/// @param[out] model Cost model
+void cost_model_init(struct cost_model *model);
+
+/// Calibrate a cost model by timing products, additions and relinearizations for a few (n, qBits)
+/// The benchmarks take about a second with FLINT
+/// @param[in,out] model Cost model
+void cost_model_calibrate(struct cost_model *model);
+
+/// Print a cost model
+/// @param[in] model Cost model
+void cost_model_print(const struct cost_model *model);
+
+/// Predict the time of a polynomial product (and reduction)
+/// @param[in] model Cost model
+/// @param[in] n Polynomial degree n
+/// @param[in] qBits Bits of q
+/// @return Predicted time in ns
+double cost_mul(const struct cost_model *model, signed long n, unsigned long qBits);
+
+/// Predict the time of a polynomial addition (and reduction)
+/// @param[in] model Cost model
+/// @param[in] n Polynomial degree n
+/// @param[in] qBits Bits of q
+/// @return Predicted time in ns
+double cost_add(const struct cost_model *model, signed long n, unsigned long qBits);
+
+/// Predict the time of a relinearization
+/// @param[in] model Cost model
+/// @param[in] n Polynomial degree n
+/// @param[in] qBits Bits of q
+/// @param[in] T Base of the evaluation key
+/// @return Predicted time in ns
+double cost_relin(const struct cost_model *model, signed long n, unsigned long qBits, int T);
+
+#endif //CUSTOM_COST_H
@@ -3,6 +3,7 @@
 #include "util.h"
 
 #include <flint/fmpz_poly.h>
+#include <pthread.h>
 #include <stdbool.h>
 
 //#region global definitions for Ziggurat algorithm
@@ -10,10 +11,12 @@
 #define UNI (0.5 + (signed) SHR3 * 0.2328306e-9)
 #define RNOR (var_h = SHR3, var_i = var_h & 127, (abs(var_h)<k[var_i])? var_h*w[var_i] : ziggurat_fallback())
 
-static unsigned long var_i, var_j, jsr;
+//Generator state is per thread, the tables are shared and computed once
+static __thread unsigned long var_i, var_j, jsr;
+static __thread int var_h;
 static unsigned long k[128];
-static int var_h;
 static double w[128], f[128];
+static pthread_once_t zig_tables_once = PTHREAD_ONCE_INIT;
 //#endregion Required for Ziggurat algorithm
 
 /// Get a uniformly random number in the range (0,1)
@@ -45,8 +48,8 @@ double dist_gauss_box_muller(const double std_deviation) {
     // -> z0 = std_dev * r * cos(phi)
     // -> z1 = std_dev * r * sin(phi)
 
-    static bool cached = false;
-    static double z1;
+    static __thread bool cached = false;
+    static __thread double z1;
 
     if (cached == false) {
         //No value cached ,generate random values
@@ -70,8 +73,8 @@ double dist_gauss_polar(const double std_deviation) {
     //x_1 = sqrt(-2 * log(r^2)/r^2) * y_1
     //x_2 = sqrt(-2 * log(r^2)/r^2) * y_2
 
-    static bool cached = false;
-    static double x2;
+    static __thread bool cached = false;
+    static __thread double x2;
 
     if (cached == false) {
         double y1, y2, r_2, t;
@@ -98,7 +101,7 @@ double dist_gauss_polar(const double std_deviation) {
 /// Fallback algorithm for RNOR #define
 static double ziggurat_fallback() {
     const double r = 3.442620f;
-    static double x, y;
+    double x, y;
     for (;;) {
         x = (double) var_h * w[var_i];
 
@@ -138,12 +141,6 @@ static void zigset() {
 
     int i;
 
-    mpz_t rand;
-    mpz_init(rand);
-    get_random(rand, 32);
-    jsr = mpz_get_ui(rand);
-    mpz_clear(rand);
-
     /* Tables for RNOR: */ q = v / exp(-.5 * d * d);
     k[0] = (unsigned long) ((d / q) * m);
     k[1] = 0;
@@ -161,10 +158,18 @@ static void zigset() {
 }
 
 double dist_gauss_ziggurat(const double std_deviation) {
-    static bool initialized = false;
+    static __thread bool initialized = false;
 
     if (initialized == false){
-        zigset();
+        pthread_once(&zig_tables_once, zigset);
+
+        //Seed the generator of this thread
+        mpz_t rand;
+        mpz_init(rand);
+        get_random(rand, 32);
+        jsr = mpz_get_ui(rand);
+        mpz_clear(rand);
+
         initialized = true;
     }
 
@@ -1,6 +1,9 @@
 #include "encoding.h"
 
 #include "plwe_poly.h"
+#include "util.h"
+
+#include <flint/ulong_extras.h>
 
 void encode(struct plwe_poly *output, const mpz_t input, const signed int b){
     if (b < 2 || b > 62){
@@ -24,6 +27,44 @@ void encode(struct plwe_poly *output, const mpz_t input, const signed int b){
     mpz_clear(remainder);
 }
 
+void encode_balanced(struct plwe_poly *output, const mpz_t input, const signed int b){
+    if (b < 2 || b > 62){
+        printf("Error. Base values are only supported in the range 2 <= b <=62");
+        return;
+    }
+
+    mpz_t scalar;
+    mpz_init_set(scalar, input);
+
+    for (int i = 0; mpz_sgn(scalar) != 0; i++){
+        signed long digit;
+
+        if (b == 2) {
+            //Non-adjacent form: odd values get the digit 2 - (v mod 4), the next digit is then 0
+            digit = mpz_odd_p(scalar) ? 2 - (signed long) mpz_fdiv_ui(scalar, 4) : 0;
+        }
+        else {
+            digit = (signed long) mpz_fdiv_ui(scalar, b);
+            if (2 * digit > b) {
+                digit -= b;
+            }
+        }
+
+        //scalar = (scalar - digit) / b
+        if (digit >= 0) {
+            mpz_sub_ui(scalar, scalar, digit);
+        }
+        else {
+            mpz_add_ui(scalar, scalar, -digit);
+        }
+        mpz_divexact_ui(scalar, scalar, b);
+
+        fmpz_poly_set_coeff_si(output->poly, i, digit);
+    }
+
+    mpz_clear(scalar);
+}
+
 void decode(mpz_t output, const struct plwe_poly *input, const signed int b){
     if (b < 2 || b > 62){
         printf("Error. Base values are only supported in the range 2 <= b <=62");
@@ -44,3 +85,336 @@ void decode(mpz_t output, const struct plwe_poly *input, const signed int b){
     mpz_clear(coeff);
     mpz_clear(base);
 }
+
+void encode_si(struct plwe_poly *output, signed long input, const signed int b){
+    if (b < 2){
+        printf("Error. Base values are only supported in the range 2 <= b");
+        return;
+    }
+
+    fmpz_poly_struct *poly = output->poly;
+    signed long length = 0;
+
+    fmpz_poly_fit_length(poly, INT_BIT_SIZE * 2);  //at most 64 digits for b = 2
+
+    //Digits keep the sign of the input like encode
+    while (input != 0) {
+        fmpz_set_si(poly->coeffs + length, input % b);
+        input /= b;
+        length += 1;
+    }
+
+    //Remove previous content
+    for (signed long i = length; i < poly->length; i++) {
+        fmpz_zero(poly->coeffs + i);
+    }
+
+    _fmpz_poly_set_length(poly, length);
+}
+
+void encode_si_balanced(struct plwe_poly *output, signed long input, const signed int b){
+    if (b < 2){
+        printf("Error. Base values are only supported in the range 2 <= b");
+        return;
+    }
+
+    fmpz_poly_struct *poly = output->poly;
+    signed long length = 0;
+
+    fmpz_poly_fit_length(poly, INT_BIT_SIZE * 2 + 1);  //at most 65 digits for the non-adjacent form
+
+    while (input != 0) {
+        signed long digit;
+
+        if (b == 2) {
+            //Non-adjacent form: odd values get the digit 2 - (v mod 4), the next digit is then 0
+            digit = (input & 1) ? 2 - (signed long) ((unsigned long) input & 3) : 0;
+        }
+        else {
+            //Move the truncated remainder in (-b, b) into (-b/2, b/2]
+            digit = input % b;
+            if (2 * digit > b) {
+                digit -= b;
+            }
+            else if (2 * digit <= -b) {
+                digit += b;
+            }
+        }
+
+        fmpz_set_si(poly->coeffs + length, digit);
+
+        //(input - digit) / b without overflow at the limits of signed long, input % b - digit is 0 or +-b
+        input = input / b + (input % b - digit) / b;
+        length += 1;
+    }
+
+    //Remove previous content
+    for (signed long i = length; i < poly->length; i++) {
+        fmpz_zero(poly->coeffs + i);
+    }
+
+    _fmpz_poly_set_length(poly, length);
+}
+
+signed long decode_si(const struct plwe_poly *input, const signed int b){
+    if (b < 2){
+        printf("Error. Base values are only supported in the range 2 <= b");
+        return 0;
+    }
+
+    const fmpz *coeffs = input->poly->coeffs;
+    unsigned long value = 0;
+
+    //Horner scheme from the highest non-zero coefficient, unsigned arithmetic wraps mod 2^64:
+    //balanced digits of values near the limits of signed long have intermediate values out of range
+    for (signed long i = fmpz_poly_length(input->poly); i > 0; i--) {
+        value = value * b + (unsigned long) fmpz_get_si(coeffs + i - 1);
+    }
+
+    return (signed long) value;
+}
+
+void encode_si_vec(struct plwe_poly *output, const signed long *input, unsigned long count, const signed int b){
+    for (unsigned long i = 0; i < count; i++) {
+        encode_si(&output[i], input[i], b);
+    }
+}
+
+void decode_si_vec(signed long *output, const struct plwe_poly *input, unsigned long count, const signed int b){
+    for (unsigned long i = 0; i < count; i++) {
+        output[i] = decode_si(&input[i], b);
+    }
+}
+
+/// Find a primitive 2n-th root of unity mod t
+/// @param[in] t Prime with t = 1 mod 2n
+/// @param[in] n Polynomial degree n (power of 2)
+/// @return psi with psi^n = -1 mod t
+static ulong primitive_root_2n(ulong t, signed long n) {
+    ulong e = (t - 1) / (2 * n);
+
+    //x^((t-1)/2n) has order dividing 2n, it is primitive iff its n-th power is -1
+    for (ulong x = 2; x < t; x++) {
+        ulong psi = n_powmod2(x, (signed long) e, t);
+        if (n_powmod2(psi, n, t) == t - 1) {
+            return psi;
+        }
+    }
+
+    return 0;
+}
+
+/// Cyclic number theoretic transform in place, a_i = sum_j a_j w^(ij) mod t
+/// @param[in,out] a Array of size n
+/// @param[in] n Size (power of 2)
+/// @param[in] w Primitive n-th root of unity mod t
+/// @param[in] t Prime modulus
+static void ntt_cyclic(ulong *a, signed long n, ulong w, ulong t) {
+    ulong tinv = n_preinvert_limb(t);
+
+    //Bit reversal permutation
+    for (signed long i = 1, j = 0; i < n; i++) {
+        signed long bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+
+        if (i < j) {
+            ulong tmp = a[i];
+            a[i] = a[j];
+            a[j] = tmp;
+        }
+    }
+
+    //Butterflies
+    for (signed long len = 2; len <= n; len <<= 1) {
+        ulong wlen = n_powmod2_ui_preinv(w, n / len, t, tinv);
+
+        for (signed long i = 0; i < n; i += len) {
+            ulong wk = 1;
+
+            for (signed long j = 0; j < len / 2; j++) {
+                ulong u = a[i + j];
+                ulong v = n_mulmod2_preinv(a[i + j + len / 2], wk, t, tinv);
+                a[i + j] = n_addmod(u, v, t);
+                a[i + j + len / 2] = n_submod(u, v, t);
+                wk = n_mulmod2_preinv(wk, wlen, t, tinv);
+            }
+        }
+    }
+}
+
+/// Check if t allows batching for polynomials of degree n
+static int batch_check(ulong t, signed long n) {
+    if (t < 3 || (t - 1) % (2 * n) != 0 || !n_is_prime(t)) {
+        printf("Error. Batching requires a prime t = 1 mod 2n.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+unsigned long batch_modulus(unsigned long bits, signed long n) {
+    ulong step = 2 * n;
+
+    //Smallest candidate k*2n+1 with the requested bit-size
+    ulong t = ((1UL << (bits - 1)) + step - 1) / step * step + 1;
+
+    for (; n_sizeinbase(t, 2) == bits; t += step) {
+        if (n_is_prime(t)) {
+            return t;
+        }
+    }
+
+    return 0;
+}
+
+int encode_batch(struct plwe_poly *output, const signed long *input, unsigned long count, unsigned long t) {
+    signed long n = output->n;
+
+    if (batch_check(t, n) != 0) {
+        return 1;
+    }
+
+    if (count > n) {
+        printf("Error. At most n=%ld values fit into the slots.\n", n);
+        return 1;
+    }
+
+    ulong *a = calloc(n, sizeof(ulong));
+    ulong tinv = n_preinvert_limb(t);
+    ulong psi = primitive_root_2n(t, n);
+    ulong psi_inv = n_invmod(psi, t);
+    ulong n_inv = n_invmod(n % t, t);
+
+    for (unsigned long i = 0; i < count; i++) {
+        signed long r = input[i] % (signed long) t;
+        a[i] = r < 0 ? (ulong) (r + (signed long) t) : (ulong) r;
+    }
+
+    //Interpolate: a_j = psi^-j * n^-1 * sum_i slot_i * w^-ij with w = psi^2
+    ntt_cyclic(a, n, n_mulmod2_preinv(psi_inv, psi_inv, t, tinv), t);
+
+    fmpz_poly_zero(output->poly);
+    fmpz_poly_fit_length(output->poly, n);
+
+    ulong factor = n_inv;
+    for (signed long j = 0; j < n; j++) {
+        fmpz_poly_set_coeff_ui(output->poly, j, n_mulmod2_preinv(a[j], factor, t, tinv));
+        factor = n_mulmod2_preinv(factor, psi_inv, t, tinv);
+    }
+
+    free(a);
+
+    return 0;
+}
+
+int decode_batch(signed long *output, const struct plwe_poly *input, unsigned long t) {
+    signed long n = input->n;
+
+    if (batch_check(t, n) != 0) {
+        return 1;
+    }
+
+    ulong *a = malloc(n * sizeof(ulong));
+    ulong tinv = n_preinvert_limb(t);
+    ulong psi = primitive_root_2n(t, n);
+
+    fmpz_t coeff;
+    fmpz_init(coeff);
+
+    //Evaluate at psi^(2i+1): slot_i = sum_j (a_j psi^j) w^ij with w = psi^2
+    ulong factor = 1;
+    for (signed long j = 0; j < n; j++) {
+        fmpz_poly_get_coeff_fmpz(coeff, input->poly, j);
+        a[j] = n_mulmod2_preinv(fmpz_fdiv_ui(coeff, t), factor, t, tinv);
+        factor = n_mulmod2_preinv(factor, psi, t, tinv);
+    }
+
+    fmpz_clear(coeff);
+
+    ntt_cyclic(a, n, n_mulmod2_preinv(psi, psi, t, tinv), t);
+
+    for (signed long i = 0; i < n; i++) {
+        output[i] = a[i] > t / 2 ? (signed long) a[i] - (signed long) t : (signed long) a[i];
+    }
+
+    free(a);
+
+    return 0;
+}
+
+/// Compute the amount of base b digits of a value
+static unsigned long digits(unsigned long value, signed int b) {
+    unsigned long count = 1;
+
+    while (value >= (unsigned long) b) {
+        value /= b;
+        count += 1;
+    }
+
+    return count;
+}
+
+unsigned long packing_stride(unsigned long max_value, unsigned long max_scalar, unsigned long scalar_muls, signed int b) {
+    return digits(max_value, b) + scalar_muls * (digits(max_scalar, b) - 1);
+}
+
+int encode_packed(struct plwe_poly *output, const signed long *input, unsigned long count, unsigned long stride, signed int b) {
+    if (b < 2 || b > 62){
+        printf("Error. Base values are only supported in the range 2 <= b <=62");
+        return 1;
+    }
+
+    if (stride == 0 || count * stride > output->n) {
+        printf("Error. %ld values with stride %ld do not fit into n=%ld coefficients.\n", count, stride, output->n);
+        return 1;
+    }
+
+    fmpz_poly_zero(output->poly);
+    fmpz_poly_fit_length(output->poly, count * stride);
+
+    for (unsigned long i = 0; i < count; i++) {
+        signed long scalar = input[i];
+
+        //Digits keep the sign of the value like encode
+        for (unsigned long d = i * stride; scalar != 0; d++) {
+            fmpz_poly_set_coeff_si(output->poly, d, scalar % b);
+            scalar /= b;
+        }
+    }
+
+    return 0;
+}
+
+int decode_packed(signed long *output, const struct plwe_poly *input, unsigned long count, unsigned long stride, signed int b) {
+    if (b < 2 || b > 62){
+        printf("Error. Base values are only supported in the range 2 <= b <=62");
+        return 1;
+    }
+
+    if (stride == 0 || count * stride > input->n) {
+        printf("Error. %ld values with stride %ld do not fit into n=%ld coefficients.\n", count, stride, input->n);
+        return 1;
+    }
+
+    fmpz_t coeff;
+    fmpz_init(coeff);
+
+    for (unsigned long i = 0; i < count; i++) {
+        signed long value = 0;
+
+        //Horner scheme from the highest coefficient of the value
+        for (unsigned long d = (i + 1) * stride; d > i * stride; d--) {
+            fmpz_poly_get_coeff_fmpz(coeff, input->poly, d - 1);
+            value = value * b + fmpz_get_si(coeff);
+        }
+
+        output[i] = value;
+    }
+
+    fmpz_clear(coeff);
+
+    return 0;
+}
@@ -12,6 +12,13 @@ struct plwe_poly;   /// defined in plwe_poly.h
 /// @param[in] b Base
 void encode(struct plwe_poly *output, const mpz_t input, signed int b);
 
+/// Encode an arbitrary sized integer to a polynomial using balanced digits in (-b/2, b/2]
+/// For b = 2 the non-adjacent form with digits in {-1, 0, 1} is used, decode works unchanged
+/// @param[out] output Polynomial
+/// @param[in] input Integer
+/// @param[in] b Base
+void encode_balanced(struct plwe_poly *output, const mpz_t input, signed int b);
+
 /// Decode a plwe_poly to a mpz_t
 
 /// Decode a polynomial to an arbitrary sized integer
@@ -20,4 +27,89 @@ void encode(struct plwe_poly *output, const mpz_t input, signed int b);
 /// @param[in] b Base
 void decode(mpz_t output, const struct plwe_poly *input, signed int b);
 
+/// Encode a native integer to a polynomial without arbitrary precision arithmetic
+/// @param[out] output Polynomial
+/// @param[in] input Integer
+/// @param[in] b Base
+void encode_si(struct plwe_poly *output, signed long input, signed int b);
+
+/// Encode a native integer to a polynomial using balanced digits in (-b/2, b/2] (non-adjacent form for b = 2)
+/// @param[out] output Polynomial
+/// @param[in] input Integer
+/// @param[in] b Base
+void encode_si_balanced(struct plwe_poly *output, signed long input, signed int b);
+
+/// Decode a polynomial to a native integer, only the coefficients up to the degree of the polynomial are read
+/// The result must fit into a signed long
+/// @param[in] input Polynomial
+/// @param[in] b Base
+/// @return Integer
+signed long decode_si(const struct plwe_poly *input, signed int b);
+
+/// Encode an array of native integers to an array of initialized polynomials
+/// @param[out] output Polynomials (count)
+/// @param[in] input Integers (count)
+/// @param[in] count Amount of integers
+/// @param[in] b Base
+void encode_si_vec(struct plwe_poly *output, const signed long *input, unsigned long count, signed int b);
+
+/// Decode an array of polynomials to an array of native integers
+/// @param[out] output Integers (count)
+/// @param[in] input Polynomials (count)
+/// @param[in] count Amount of polynomials
+/// @param[in] b Base
+void decode_si_vec(signed long *output, const struct plwe_poly *input, unsigned long count, signed int b);
+
+/// Find the smallest prime t of a certain bit-size with t = 1 mod 2n, which allows batching
+/// @param[in] bits Bit-size of t
+/// @param[in] n Polynomial degree n
+/// @return Plaintext modulus t or 0 if there is none
+unsigned long batch_modulus(unsigned long bits, signed long n);
+
+/// Encode a vector of integers into the plaintext slots of a polynomial (CRT batching)
+/// Slot i holds the value of the polynomial at psi^(2i+1) mod t for a primitive 2n-th root of unity psi,
+/// eval_add and eval_mul therefore act slot-wise on all n values at once
+/// @param[out] output Polynomial
+/// @param[in] input Integers, missing slots are set to 0
+/// @param[in] count Amount of integers (<= n)
+/// @param[in] t Plaintext modulus t, must be a prime with t = 1 mod 2n
+/// @return 0 if ok, != 0 if t does not allow batching
+int encode_batch(struct plwe_poly *output, const signed long *input, unsigned long count, unsigned long t);
+
+/// Decode the plaintext slots of a polynomial to a vector of integers in (-t/2, t/2]
+/// @param[out] output Array of size >= n
+/// @param[in] input Polynomial
+/// @param[in] t Plaintext modulus t, must be a prime with t = 1 mod 2n
+/// @return 0 if ok, != 0 if t does not allow batching
+int decode_batch(signed long *output, const struct plwe_poly *input, unsigned long t);
+
+/// Compute the coefficient stride of a packed encoding, i.e. the amount of coefficients reserved per value
+/// Multiplying with a scalar of k digits moves k-1 digits into the next higher coefficients,
+/// the stride includes these guard coefficients for the whole circuit
+/// @param[in] max_value Maximum absolute value of the packed integers and results
+/// @param[in] max_scalar Maximum absolute value of plain scalars the ciphertext is multiplied with
+/// @param[in] scalar_muls Amount of consecutive plain scalar multiplications
+/// @param[in] b Base
+/// @return Stride
+unsigned long packing_stride(unsigned long max_value, unsigned long max_scalar, unsigned long scalar_muls, signed int b);
+
+/// Encode multiple integers into a polynomial, value i occupies the coefficients [i*stride, (i+1)*stride)
+/// Works for any t, supports additions and plain scalar multiplications
+/// @param[out] output Polynomial
+/// @param[in] input Integers
+/// @param[in] count Amount of integers (count * stride <= n)
+/// @param[in] stride Coefficient stride (see packing_stride)
+/// @param[in] b Base
+/// @return 0 if ok, != 0 if the integers do not fit into the polynomial
+int encode_packed(struct plwe_poly *output, const signed long *input, unsigned long count, unsigned long stride, signed int b);
+
+/// Decode multiple integers packed into a polynomial
+/// @param[out] output Array of size >= count
+/// @param[in] input Polynomial
+/// @param[in] count Amount of integers
+/// @param[in] stride Coefficient stride used for encoding
+/// @param[in] b Base
+/// @return 0 if ok, != 0 if the integers do not fit into the polynomial
+int decode_packed(signed long *output, const struct plwe_poly *input, unsigned long count, unsigned long stride, signed int b);
+
 #endif //CUSTOM_ENCODING_H
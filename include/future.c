@@ -0,0 +1,356 @@
+#include "future.h"
+
+#include "asym.h"
+#include "message.h"
+#include "threading.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define FUTURE_WAIT_NS 1000000      // Sleep of a waiting thread that found no task to help with
+
+//Status, dependencies and dependents of all futures are protected by one lock, operations are coarse grained
+static pthread_mutex_t future_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t future_cond = PTHREAD_COND_INITIALIZER;      // Broadcast whenever a future finished
+
+struct async_args {
+    struct thread_pool *pool;
+    struct message *result;
+    struct message *message1;
+    struct message *message2;
+    struct plwe_poly *m;
+    const struct key *key;
+    struct key_eval *key_eval;
+};
+
+static void future_retain(struct future *future) {
+    atomic_fetch_add(&future->refs, 1);
+}
+
+void future_release(struct future *future) {
+    if (atomic_fetch_sub(&future->refs, 1) != 1) {
+        return;
+    }
+
+    if (future->owns_arg) {
+        free(future->arg);
+    }
+    free(future->dependents);
+    free(future);
+}
+
+static void future_launch(struct future *future);
+
+/// Finish a future, release the dependents waiting for it and drop the reference of the scheduler
+/// @param[in,out] future Future
+/// @param[in] status Final status
+static void future_finish(struct future *future, int status) {
+    //No dependents are added once the status is set
+    pthread_mutex_lock(&future_lock);
+    future->status = status;
+
+    //Exactly one dependency observes the last decrement of a dependent and launches it
+    int *ready = malloc(future->n_dependents * sizeof(int));
+
+    for (unsigned long i = 0; i < future->n_dependents; i++) {
+        struct future *dependent = future->dependents[i];
+        if (status != future_ok) {
+            dependent->failed = 1;
+        }
+
+        ready[i] = (--dependent->remaining == 0);
+        if (ready[i] && dependent->failed) {
+            dependent->func = NULL;
+        }
+    }
+    pthread_cond_broadcast(&future_cond);
+    pthread_mutex_unlock(&future_lock);
+
+    //Launch outside of the lock, a failed dependent finishes (and locks) immediately
+    for (unsigned long i = 0; i < future->n_dependents; i++) {
+        if (ready[i]) {
+            future_launch(future->dependents[i]);
+        }
+        future_release(future->dependents[i]);
+    }
+
+    free(ready);
+    future_release(future);
+}
+
+static void future_run(void *arg) {
+    struct future *future = arg;
+    future_finish(future, future->func(future->arg));
+}
+
+/// Run a future whose dependencies all finished
+/// @param[in,out] future Future, func is NULL if a dependency failed
+static void future_launch(struct future *future) {
+    if (future->func == NULL) {
+        future_finish(future, future_dependency_failed);
+    }
+    else {
+        thread_pool_submit(future->pool, NULL, future_run, future);
+    }
+}
+
+static struct future * future_create(struct thread_pool *pool, int (*func)(void *arg), void *arg, int owns_arg,
+                                     struct future *const deps[], unsigned long n_deps) {
+    struct future *future = malloc(sizeof(struct future));
+    future->pool = pool;
+    atomic_init(&future->refs, 2);          //Caller and scheduler
+    future->status = future_pending;
+    future->remaining = n_deps + 1;         //Not launched while dependencies are still being registered
+    future->failed = 0;
+    future->dependents = NULL;
+    future->n_dependents = 0;
+    future->dependents_capacity = 0;
+    future->func = func;
+    future->arg = arg;
+    future->owns_arg = owns_arg;
+
+    pthread_mutex_lock(&future_lock);
+    for (unsigned long i = 0; i < n_deps; i++) {
+        struct future *dep = deps[i];
+
+        if (dep->status != future_pending) {
+            //Already finished
+            if (dep->status != future_ok) {
+                future->failed = 1;
+            }
+            future->remaining--;
+            continue;
+        }
+
+        if (dep->n_dependents == dep->dependents_capacity) {
+            dep->dependents_capacity = (dep->dependents_capacity == 0) ? 4 : 2 * dep->dependents_capacity;
+            dep->dependents = realloc(dep->dependents, dep->dependents_capacity * sizeof(struct future *));
+        }
+
+        future_retain(future);          //Released by the dependency once it finished
+        dep->dependents[dep->n_dependents++] = future;
+    }
+
+    int ready = (--future->remaining == 0);
+    if (ready && future->failed) {
+        future->func = NULL;
+    }
+    pthread_mutex_unlock(&future_lock);
+
+    if (ready) {
+        future_launch(future);
+    }
+
+    return future;
+}
+
+struct future * future_submit(struct thread_pool *pool, int (*func)(void *arg), void *arg,
+                              struct future *const deps[], unsigned long n_deps) {
+    return future_create(pool, func, arg, 0, deps, n_deps);
+}
+
+int future_status(struct future *future) {
+    pthread_mutex_lock(&future_lock);
+    int status = future->status;
+    pthread_mutex_unlock(&future_lock);
+
+    return status;
+}
+
+/// Find a finished future
+/// @param[in] futures Futures
+/// @param[in] count Amount of futures
+/// @return Index of a finished future or count if none finished, future_lock must be held
+static unsigned long find_finished(struct future *const futures[], unsigned long count) {
+    for (unsigned long i = 0; i < count; i++) {
+        if (futures[i]->status != future_pending) {
+            return i;
+        }
+    }
+
+    return count;
+}
+
+unsigned long future_wait_any(struct future *const futures[], unsigned long count) {
+    struct thread_pool *pool = futures[0]->pool;
+    unsigned long index;
+
+    while (1) {
+        pthread_mutex_lock(&future_lock);
+        index = find_finished(futures, count);
+        pthread_mutex_unlock(&future_lock);
+
+        if (index < count) {
+            return index;
+        }
+
+        //Help instead of blocking, the awaited operations may be queued
+        if (thread_pool_help(pool)) {
+            continue;
+        }
+
+        //Nothing to help with, wake up regularly as running operations may queue new tasks
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += FUTURE_WAIT_NS;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        pthread_mutex_lock(&future_lock);
+        if (find_finished(futures, count) == count) {
+            pthread_cond_timedwait(&future_cond, &future_lock, &deadline);
+        }
+        pthread_mutex_unlock(&future_lock);
+    }
+}
+
+int future_wait(struct future *future) {
+    struct future *futures[1] = {future};
+    future_wait_any(futures, 1);
+
+    return future_status(future);
+}
+
+int future_wait_all(struct future *const futures[], unsigned long count) {
+    int status = future_ok;
+
+    for (unsigned long i = 0; i < count; i++) {
+        int s = future_wait(futures[i]);
+        if (status == future_ok) {
+            status = s;
+        }
+    }
+
+    return status;
+}
+
+// Typed operations, inputs are checked when they are available, i.e. when the operation runs
+
+static int encrypt_op(void *arg) {
+    struct async_args *args = arg;
+
+    if ((args->result->cIndex + 1) >= args->result->max_len) {
+        return future_invalid_input;
+    }
+
+    encrypt(args->result, args->m, args->key);
+    return future_ok;
+}
+
+static int decrypt_op(void *arg) {
+    struct async_args *args = arg;
+
+    if (args->message1->cIndex == 0) {
+        return future_invalid_input;
+    }
+
+    decrypt(args->m, args->message1, args->key);
+    return future_ok;
+}
+
+static int eval_add_op(void *arg) {
+    struct async_args *args = arg;
+    unsigned long len = (args->message1->cIndex > args->message2->cIndex) ? args->message1->cIndex : args->message2->cIndex;
+
+    if (args->message1->cIndex == 0 || args->message2->cIndex == 0 || len > args->result->max_len) {
+        return future_invalid_input;
+    }
+
+    eval_add(args->result, args->message1, args->message2);
+    return future_ok;
+}
+
+static int eval_mul_op(void *arg) {
+    struct async_args *args = arg;
+
+    if (args->message1->cIndex < 2 || args->message2->cIndex < 2 ||
+        args->message1->cIndex + args->message2->cIndex - 1 > args->result->max_len) {
+        return future_invalid_input;
+    }
+
+    eval_mul_parallel(args->pool, args->result, args->message1, args->message2);
+    return future_ok;
+}
+
+static int relinearize_op(void *arg) {
+    struct async_args *args = arg;
+
+    if (args->message1->cIndex != 3) {
+        return future_invalid_input;
+    }
+
+    message_relinearize(args->message1, args->key_eval);
+    return future_ok;
+}
+
+static struct async_args * async_args_init(struct thread_pool *pool) {
+    struct async_args *args = calloc(1, sizeof(struct async_args));
+    args->pool = pool;
+
+    return args;
+}
+
+/// Expand a seeded input in the submitting thread, concurrent futures then only read it
+/// Without dependencies no task writes the input yet, otherwise it might be the result of a dependency
+static void async_expand(struct message *message, unsigned long n_deps) {
+    if (n_deps == 0) {
+        message_expand(message);
+    }
+}
+
+struct future * encrypt_async(struct thread_pool *pool, struct message *message, const struct plwe_poly *m,
+                              const struct key *key, struct future *const deps[], unsigned long n_deps) {
+    struct async_args *args = async_args_init(pool);
+    args->result = message;
+    args->m = (struct plwe_poly *) m;   //Only read by encrypt
+    args->key = key;
+
+    return future_create(pool, encrypt_op, args, 1, deps, n_deps);
+}
+
+struct future * decrypt_async(struct thread_pool *pool, struct plwe_poly *m, struct message *message,
+                              const struct key *key, struct future *const deps[], unsigned long n_deps) {
+    struct async_args *args = async_args_init(pool);
+    args->m = m;
+    args->message1 = message;
+    args->key = key;
+
+    async_expand(message, n_deps);
+    return future_create(pool, decrypt_op, args, 1, deps, n_deps);
+}
+
+struct future * eval_add_async(struct thread_pool *pool, struct message *result, struct message *message1,
+                               struct message *message2, struct future *const deps[], unsigned long n_deps) {
+    struct async_args *args = async_args_init(pool);
+    args->result = result;
+    args->message1 = message1;
+    args->message2 = message2;
+
+    async_expand(message1, n_deps);
+    async_expand(message2, n_deps);
+    return future_create(pool, eval_add_op, args, 1, deps, n_deps);
+}
+
+struct future * eval_mul_async(struct thread_pool *pool, struct message *result, struct message *message1,
+                               struct message *message2, struct future *const deps[], unsigned long n_deps) {
+    struct async_args *args = async_args_init(pool);
+    args->result = result;
+    args->message1 = message1;
+    args->message2 = message2;
+
+    async_expand(message1, n_deps);
+    async_expand(message2, n_deps);
+    return future_create(pool, eval_mul_op, args, 1, deps, n_deps);
+}
+
+struct future * relinearize_async(struct thread_pool *pool, struct message *message, struct key_eval *key_eval,
+                                  struct future *const deps[], unsigned long n_deps) {
+    struct async_args *args = async_args_init(pool);
+    args->message1 = message;
+    args->key_eval = key_eval;
+
+    return future_create(pool, relinearize_op, args, 1, deps, n_deps);
+}
@@ -0,0 +1,132 @@
+#ifndef CUSTOM_FUTURE_H
+#define CUSTOM_FUTURE_H
+
+#include <stdatomic.h>
+
+//Forward declarations
+struct key;         /// defined in key.h
+struct key_eval;    /// defined in key.h
+struct message;     /// defined in message.h
+struct plwe_poly;   /// defined in plwe_poly.h
+struct thread_pool; /// defined in threading.h
+
+enum future_status {
+    future_ok = 0,
+    future_pending = 1,             // Not finished yet
+    future_invalid_input = 2,       // The operation rejected its inputs (e.g. ciphertext too long)
+    future_dependency_failed = 3,   // A dependency did not finish with future_ok, the operation was not run
+};
+
+/// Handle of an asynchronous operation
+/// Futures are reference counted, every returned future must be released with future_release
+struct future {
+    struct thread_pool *pool;
+    atomic_int refs;
+    int status;                     // enum future_status
+    unsigned long remaining;        // Unfinished dependencies (+1 while the future is being scheduled)
+    int failed;                     // != 0 if a dependency failed
+    struct future **dependents;     // Futures waiting for this one
+    unsigned long n_dependents;
+    unsigned long dependents_capacity;
+    int (*func)(void *arg);         // Operation, returns an enum future_status
+    void *arg;
+    int owns_arg;                   // != 0 if arg is freed together with the future
+};
+
+/// Schedule an operation on a thread pool once all dependencies finished
+/// If a dependency fails the operation is not run and the future finishes with future_dependency_failed
+/// @param[in,out] pool Thread pool
+/// @param[in] func Operation, returns future_ok or an error of enum future_status
+/// @param[in] arg Argument passed to func, owned by the caller
+/// @param[in] deps Futures the operation depends on, may be NULL if n_deps is 0
+/// @param[in] n_deps Amount of dependencies
+/// @return Future of the operation
+struct future * future_submit(struct thread_pool *pool, int (*func)(void *arg), void *arg,
+                              struct future *const deps[], unsigned long n_deps);
+
+/// Release a future, the operation continues if it has not finished yet
+/// @param[in] future Future
+void future_release(struct future *future);
+
+/// Get the status of a future without waiting
+/// @param[in] future Future
+/// @return future_pending or the final status
+int future_status(struct future *future);
+
+/// Wait until a future finished, the calling thread runs queued tasks of the pool meanwhile
+/// @param[in] future Future
+/// @return Final status
+int future_wait(struct future *future);
+
+/// Wait until all futures finished
+/// @param[in] futures Futures of the same pool
+/// @param[in] count Amount of futures
+/// @return future_ok or the first error status in the order of futures
+int future_wait_all(struct future *const futures[], unsigned long count);
+
+/// Wait until at least one future finished
+/// @param[in] futures Futures of the same pool
+/// @param[in] count Amount of futures (> 0)
+/// @return Index of a finished future
+unsigned long future_wait_any(struct future *const futures[], unsigned long count);
+
+// Asynchronous versions of the operations in asym.c and message.c
+// Inputs may be produced by the dependencies, results must not be read before the future finished
+// Seeded inputs are expanded by the submitting thread if the future has no dependencies, inputs of futures with
+// dependencies may still be written by them and are expanded into temporary copies by the operation instead
+
+/// Schedule encrypt(message, m, key)
+/// @param[in,out] pool Thread pool
+/// @param[out] message Ciphertext initialized with message_init
+/// @param[in] m Plaintext
+/// @param[in] key Key
+/// @param[in] deps Dependencies
+/// @param[in] n_deps Amount of dependencies
+/// @return Future of the operation
+struct future * encrypt_async(struct thread_pool *pool, struct message *message, const struct plwe_poly *m,
+                              const struct key *key, struct future *const deps[], unsigned long n_deps);
+
+/// Schedule decrypt(m, message, key)
+/// @param[in,out] pool Thread pool
+/// @param[out] m Plaintext initialized with plwe_poly_init
+/// @param[in] message Ciphertext
+/// @param[in] key Key
+/// @param[in] deps Dependencies
+/// @param[in] n_deps Amount of dependencies
+/// @return Future of the operation
+struct future * decrypt_async(struct thread_pool *pool, struct plwe_poly *m, struct message *message,
+                              const struct key *key, struct future *const deps[], unsigned long n_deps);
+
+/// Schedule eval_add(result, message1, message2)
+/// @param[in,out] pool Thread pool
+/// @param[out] result Result
+/// @param[in] message1 Ciphertext 1
+/// @param[in] message2 Ciphertext 2
+/// @param[in] deps Dependencies
+/// @param[in] n_deps Amount of dependencies
+/// @return Future of the operation
+struct future * eval_add_async(struct thread_pool *pool, struct message *result, struct message *message1,
+                               struct message *message2, struct future *const deps[], unsigned long n_deps);
+
+/// Schedule eval_mul_parallel(pool, result, message1, message2)
+/// @param[in,out] pool Thread pool
+/// @param[out] result Result
+/// @param[in] message1 Ciphertext 1
+/// @param[in] message2 Ciphertext 2
+/// @param[in] deps Dependencies
+/// @param[in] n_deps Amount of dependencies
+/// @return Future of the operation
+struct future * eval_mul_async(struct thread_pool *pool, struct message *result, struct message *message1,
+                               struct message *message2, struct future *const deps[], unsigned long n_deps);
+
+/// Schedule message_relinearize(message, key_eval)
+/// @param[in,out] pool Thread pool
+/// @param[in,out] message Ciphertext
+/// @param[in] key_eval Evaluation key
+/// @param[in] deps Dependencies
+/// @param[in] n_deps Amount of dependencies
+/// @return Future of the operation
+struct future * relinearize_async(struct thread_pool *pool, struct message *message, struct key_eval *key_eval,
+                                  struct future *const deps[], unsigned long n_deps);
+
+#endif //CUSTOM_FUTURE_H
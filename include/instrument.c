@@ -0,0 +1,138 @@
+#include "instrument.h"
+
+#include <string.h>
+
+static const char *counter_names[INSTRUMENT_COUNTERS] = {
+        "ring_mul", "reduction", "mod_t", "poly_alloc", "random_bytes",
+};
+
+static const char *timer_names[INSTRUMENT_TIMERS] = {
+        "poly_mul", "poly_pmod", "sample_uniform", "sample_gauss", "sample_small", "eval_add", "eval_mul",
+        "eval_add_plain", "eval_mul_plain", "relinearize", "decrypt",
+};
+
+#ifdef PLWE_INSTRUMENT
+#include <pthread.h>
+#include <stdlib.h>
+
+__thread struct instrument_thread *instrument_local = NULL;
+
+//Registry of all blocks, new blocks are pushed to the head
+static _Atomic(struct instrument_thread *) registry = NULL;
+
+//Totals at the last reset, subtracted from snapshots so that reset never writes to the blocks of other threads
+static struct instrument_snapshot baseline;
+static pthread_mutex_t baseline_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_once_t exit_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t exit_key;
+
+/// Release the block of a finished thread, its counts remain in the totals
+static void instrument_release(void *arg) {
+    struct instrument_thread *block = arg;
+    atomic_store_explicit(&block->in_use, 0, memory_order_release);
+}
+
+static void exit_key_init(void) {
+    pthread_key_create(&exit_key, instrument_release);
+}
+
+struct instrument_thread * instrument_register(void) {
+    pthread_once(&exit_key_once, exit_key_init);
+
+    struct instrument_thread *block = NULL;
+
+    //Reuse the block of a finished thread
+    for (struct instrument_thread *it = atomic_load_explicit(&registry, memory_order_acquire); it != NULL && block == NULL;
+         it = it->next) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&it->in_use, &expected, 1)) {
+            block = it;
+        }
+    }
+
+    if (block == NULL) {
+        block = calloc(1, sizeof(struct instrument_thread));
+        atomic_init(&block->in_use, 1);
+
+        block->next = atomic_load_explicit(&registry, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(&registry, &block->next, block, memory_order_release,
+                                                      memory_order_relaxed)) {
+        }
+    }
+
+    pthread_setspecific(exit_key, block);
+    instrument_local = block;
+
+    return block;
+}
+
+/// Sum all blocks
+static void instrument_total(struct instrument_snapshot *snapshot) {
+    memset(snapshot, 0, sizeof(struct instrument_snapshot));
+
+    for (struct instrument_thread *it = atomic_load_explicit(&registry, memory_order_acquire); it != NULL;
+         it = it->next) {
+        for (int i = 0; i < INSTRUMENT_COUNTERS; i++) {
+            snapshot->counters[i] += atomic_load_explicit(&it->counters[i], memory_order_relaxed);
+        }
+        for (int i = 0; i < INSTRUMENT_TIMERS; i++) {
+            snapshot->calls[i] += atomic_load_explicit(&it->calls[i], memory_order_relaxed);
+            snapshot->ns[i] += atomic_load_explicit(&it->ns[i], memory_order_relaxed);
+        }
+    }
+}
+
+void instrument_snapshot(struct instrument_snapshot *snapshot) {
+    instrument_total(snapshot);
+
+    pthread_mutex_lock(&baseline_lock);
+    for (int i = 0; i < INSTRUMENT_COUNTERS; i++) {
+        snapshot->counters[i] -= baseline.counters[i];
+    }
+    for (int i = 0; i < INSTRUMENT_TIMERS; i++) {
+        snapshot->calls[i] -= baseline.calls[i];
+        snapshot->ns[i] -= baseline.ns[i];
+    }
+    pthread_mutex_unlock(&baseline_lock);
+}
+
+void instrument_reset(void) {
+    pthread_mutex_lock(&baseline_lock);
+    instrument_total(&baseline);
+    pthread_mutex_unlock(&baseline_lock);
+}
+#else
+void instrument_snapshot(struct instrument_snapshot *snapshot) {
+    memset(snapshot, 0, sizeof(struct instrument_snapshot));
+}
+
+void instrument_reset(void) {
+}
+#endif
+
+void instrument_dump(FILE *fp, const struct instrument_snapshot *snapshot) {
+    fprintf(fp, "Instrumentation\n");
+    fprintf(fp, "----------------------------------\n");
+#ifndef PLWE_INSTRUMENT
+    fprintf(fp, "disabled (compile with -DPLWE_INSTRUMENT)\n");
+#endif
+
+    for (int i = 0; i < INSTRUMENT_COUNTERS; i++) {
+        fprintf(fp, "%-16s %12lu\n", counter_names[i], snapshot->counters[i]);
+    }
+
+    fprintf(fp, "----------------------------------\n");
+    fprintf(fp, "%-16s %12s %12s %12s\n", "timer", "calls", "total ms", "avg us");
+
+    for (int i = 0; i < INSTRUMENT_TIMERS; i++) {
+        if (snapshot->calls[i] == 0) {
+            continue;
+        }
+
+        fprintf(fp, "%-16s %12lu %12.3f %12.3f\n", timer_names[i], snapshot->calls[i], (double) snapshot->ns[i] / 1e6,
+                (double) snapshot->ns[i] / 1e3 / (double) snapshot->calls[i]);
+    }
+
+    fprintf(fp, "----------------------------------\n");
+}
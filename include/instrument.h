@@ -0,0 +1,107 @@
+#ifndef CUSTOM_INSTRUMENT_H
+#define CUSTOM_INSTRUMENT_H
+
+#include <stdio.h>
+
+/// Counters and timers of the hot paths, compiled in with -DPLWE_INSTRUMENT (see CMakeLists.txt)
+/// Without PLWE_INSTRUMENT the INSTRUMENT_* macros expand to nothing and snapshots are zero
+
+enum instrument_counter {
+    counter_ring_mul = 0,       // Ring multiplications (full, small, sparse and precached products)
+    counter_reduction = 1,      // Reductions mod (x^n + 1, q) by plwe_poly_pmod
+    counter_mod_t = 2,          // Reductions mod t by plwe_poly_mod_t
+    counter_poly_alloc = 3,     // Polynomials initialized by plwe_poly_init and plwe_poly_small_init
+    counter_random_bytes = 4,   // Bytes drawn by urandom, urandom_seed and urandom_seeded
+};
+#define INSTRUMENT_COUNTERS 5
+
+enum instrument_timer {
+    timer_poly_mul = 0,         // plwe_poly_mul
+    timer_poly_pmod = 1,        // plwe_poly_pmod
+    timer_sample_uniform = 2,   // rand_poly_uniform, rand_poly_uniform_seeded
+    timer_sample_gauss = 3,     // rand_poly_gauss, rand_poly_small_gauss
+    timer_sample_small = 4,     // rand_poly_small_ternary, rand_poly_small_hamming
+    timer_eval_add = 5,         // eval_add
+    timer_eval_mul = 6,         // eval_mul, eval_mul_parallel
+    timer_eval_add_plain = 7,   // eval_add_plain, eval_add_plain_enc
+    timer_eval_mul_plain = 8,   // eval_mul_plain, eval_mul_plain_enc
+    timer_relinearize = 9,      // message_relinearize
+    timer_decrypt = 10,         // decrypt
+};
+#define INSTRUMENT_TIMERS 11
+
+/// Sum of all threads since the last instrument_reset
+struct instrument_snapshot {
+    unsigned long counters[INSTRUMENT_COUNTERS];
+    unsigned long calls[INSTRUMENT_TIMERS];
+    unsigned long ns[INSTRUMENT_TIMERS];        // Cumulative time, nested timers are included in their callers
+};
+
+/// Sum the counters and timers of all threads, concurrent updates are not blocked
+/// @param[out] snapshot Snapshot
+void instrument_snapshot(struct instrument_snapshot *snapshot);
+
+/// Restart all counters and timers at zero (later snapshots are relative to this point)
+void instrument_reset(void);
+
+/// Print a snapshot
+/// @param[in] fp Output, e.g. stdout
+/// @param[in] snapshot Snapshot
+void instrument_dump(FILE *fp, const struct instrument_snapshot *snapshot);
+
+#ifdef PLWE_INSTRUMENT
+#include <stdatomic.h>
+#include <time.h>
+
+/// Counters of one thread, written by the owning thread only and read by snapshots
+/// Blocks are linked into a registry and never freed, blocks of finished threads are reused by new threads
+struct instrument_thread {
+    atomic_ulong counters[INSTRUMENT_COUNTERS];
+    atomic_ulong calls[INSTRUMENT_TIMERS];
+    atomic_ulong ns[INSTRUMENT_TIMERS];
+    atomic_int in_use;
+    struct instrument_thread *next;
+};
+
+extern __thread struct instrument_thread *instrument_local;
+
+/// Claim a block for the calling thread
+/// @return Block of the calling thread
+struct instrument_thread * instrument_register(void);
+
+static inline __attribute__((always_inline)) void instrument_add(atomic_ulong *value, unsigned long amount) {
+    //Single writer, a relaxed load and store is enough and needs no locked instruction
+    atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + amount, memory_order_relaxed);
+}
+
+static inline __attribute__((always_inline)) struct instrument_thread * instrument_thread(void) {
+    struct instrument_thread *local = instrument_local;
+    return (local != NULL) ? local : instrument_register();
+}
+
+static inline __attribute__((always_inline)) void instrument_count(enum instrument_counter counter, unsigned long amount) {
+    instrument_add(&instrument_thread()->counters[counter], amount);
+}
+
+static inline __attribute__((always_inline)) unsigned long instrument_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long) ts.tv_sec * 1000000000UL + (unsigned long) ts.tv_nsec;
+}
+
+static inline __attribute__((always_inline)) void instrument_time(enum instrument_timer timer, unsigned long start) {
+    struct instrument_thread *local = instrument_thread();
+    instrument_add(&local->calls[timer], 1);
+    instrument_add(&local->ns[timer], instrument_now() - start);
+}
+
+#define INSTRUMENT_COUNT(counter, amount) instrument_count(counter, amount)
+#define INSTRUMENT_START(timer) const unsigned long instrument_start_##timer = instrument_now()
+#define INSTRUMENT_STOP(timer) instrument_time(timer, instrument_start_##timer)
+#else
+#define INSTRUMENT_COUNT(counter, amount) ((void) 0)
+#define INSTRUMENT_START(timer) ((void) 0)
+#define INSTRUMENT_STOP(timer) ((void) 0)
+#endif
+
+#endif //CUSTOM_INSTRUMENT_H
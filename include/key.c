@@ -3,7 +3,9 @@
 #include "asym.h"
 #include "message.h"
 
+#include <ctype.h>
 #include <stdio.h>
+#include <string.h>
 
 /// Save a polynomial to a file
 /// @param fp File pointer
@@ -12,8 +14,26 @@ static void write_plwe_poly(struct plwe_poly *poly, FILE *fp);
 
 /// Read a Polynomial from a file
 /// @param fp File pointer
-/// @param poly Polynomial
-static void read_plwe_poly(struct plwe_poly *poly, FILE *fp);
+/// @param poly Polynomial, initialized only if ok
+/// @return 0 if ok, != 0 otherwise
+static int read_plwe_poly(struct plwe_poly *poly, FILE *fp);
+
+/// Save a small polynomial to a file
+/// @param fp File pointer
+/// @param small Small polynomial
+static void write_plwe_poly_small(struct plwe_poly_small *small, FILE *fp);
+
+/// Read a small polynomial from a file
+/// @param fp File pointer
+/// @param small Small polynomial, initialized only if ok
+/// @return 0 if ok, != 0 otherwise
+static int read_plwe_poly_small(struct plwe_poly_small *small, FILE *fp);
+
+/// Read the secret key of the legacy format (polynomial mod q) as small polynomial
+/// @param fp File pointer
+/// @param small Small polynomial, initialized only if ok
+/// @return 0 if ok, != 0 otherwise
+static int read_plwe_poly_small_legacy(struct plwe_poly_small *small, FILE *fp);
 
 void key_init(struct key *key, const struct settings *settings) {
     key->settings = *settings;
@@ -46,7 +66,8 @@ void key_init_eval(struct key_eval *key_eval, const struct key *key, const int T
         plwe_poly_init(&key_eval->ek0[i], key->settings.q, key->settings.n);
         plwe_poly_init(&key_eval->ek1[i], key->settings.q, key->settings.n);
 
-        plwe_poly_mul(&m, &key->sk, &key->sk);                             //te = s^2
+        plwe_poly_small_get_poly(&m, &key->sk);
+        plwe_poly_mul_small(&m, &m, &key->sk);                             //te = s^2
         mpz_set_si(t_power, T);
         mpz_pow_ui(t_power, t_power, i);
         plwe_poly_scalar_mul_mpz(&m, &m, t_power);                        //te = s^2 * T^i
@@ -64,6 +85,7 @@ void key_init_eval(struct key_eval *key_eval, const struct key *key, const int T
     }
 
     mpz_clear(t_power);
+    plwe_poly_clear(&m);
 }
 
 void key_clear_eval(struct key_eval *key_eval) {
@@ -79,45 +101,208 @@ static void write_plwe_poly(struct plwe_poly *poly, FILE *fp) {
     fmpz_poly_fprint(fp, poly->poly);           //poly
 }
 
-static void read_plwe_poly(struct plwe_poly *poly, FILE *fp) {
+static int read_plwe_poly(struct plwe_poly *poly, FILE *fp) {
     long n;
+
+    if (fscanf(fp, " %ld ", &n) != 1 || n <= 0) {                    //n
+        printf("Error, invalid polynomial degree in key file!\n");
+        return 1;
+    }
+
     fmpz_t q;
     fmpz_init(q);
 
-    int result = fscanf(fp, " %ld ", &n);             //n
+    if (fmpz_inp_raw(q, fp) == 0 || fmpz_cmp_ui(q, 2) < 0) {         //q
+        printf("Error, invalid modulus in key file!\n");
+        fmpz_clear(q);
+        return 1;
+    }
+
+    plwe_poly_init(poly, q, n);
+    fmpz_clear(q);
 
-    if (result != 1) {
-        //return value is number of matched elements
-        printf("Error, fscanf failed!");
+    if (fmpz_poly_fread(fp, poly->poly) <= 0 || fmpz_poly_length(poly->poly) > n) {    //poly
+        printf("Error, invalid polynomial in key file!\n");
+        plwe_poly_clear(poly);
+        return 1;
     }
 
-    fmpz_inp_raw(q, fp);                                     //q
+    return 0;
+}
 
-    plwe_poly_init(poly, q, n);
+static void write_plwe_poly_small(struct plwe_poly_small *small, FILE *fp) {
+    fprintf(fp, " %ld ", small->n);      //n
 
-    fmpz_clear(q);
+    for (signed long i = 0; i < small->n; i++) {
+        fprintf(fp, "%d ", small->coeffs[i]);
+    }
+}
+
+static int read_plwe_poly_small(struct plwe_poly_small *small, FILE *fp) {
+    long n;
+
+    if (fscanf(fp, " %ld ", &n) != 1 || n <= 0) {
+        printf("Error, invalid polynomial degree in key file!\n");
+        return 1;
+    }
+
+    plwe_poly_small_init(small, n);
 
-    fmpz_poly_fread(fp, poly->poly);                         //poly
+    for (signed long i = 0; i < n; i++) {
+        int coeff;
+
+        if (fscanf(fp, "%d ", &coeff) != 1 || coeff < INT16_MIN || coeff > INT16_MAX) {
+            printf("Error, invalid coefficient in key file!\n");
+            plwe_poly_small_clear(small);
+            return 1;
+        }
+
+        small->coeffs[i] = (int16_t) coeff;
+    }
+
+    plwe_poly_small_normalise(small);
+
+    return 0;
 }
 
-void key_save(struct key *key, const char *path) {
+static int read_plwe_poly_small_legacy(struct plwe_poly_small *small, FILE *fp) {
+    struct plwe_poly poly;
+
+    if (read_plwe_poly(&poly, fp) != 0) {
+        return 1;
+    }
+
+    //Coefficients are stored mod q, take the representatives in (-q/2, q/2]
+    fmpz_t coeff, half_q;
+    fmpz_init(coeff);
+    fmpz_init(half_q);
+    fmpz_fdiv_q_2exp(half_q, poly.mod, 1);
+
+    plwe_poly_small_init(small, poly.n);
+
+    int result = 0;
+    for (signed long i = 0; i < poly.n && result == 0; i++) {
+        fmpz_poly_get_coeff_fmpz(coeff, poly.poly, i);
+        if (fmpz_cmp(coeff, half_q) > 0) {
+            fmpz_sub(coeff, coeff, poly.mod);
+        }
+
+        if (!fmpz_fits_si(coeff) || fmpz_get_si(coeff) < INT16_MIN || fmpz_get_si(coeff) > INT16_MAX) {
+            printf("Error, secret key coefficient too large for small polynomials!\n");
+            plwe_poly_small_clear(small);
+            result = 1;
+        }
+        else {
+            small->coeffs[i] = (int16_t) fmpz_get_si(coeff);
+        }
+    }
+
+    if (result == 0) {
+        plwe_poly_small_normalise(small);
+    }
+
+    fmpz_clear(coeff);
+    fmpz_clear(half_q);
+    plwe_poly_clear(&poly);
+
+    return result;
+}
+
+int key_save(struct key *key, const char *path) {
     FILE *fp;
     fp = fopen(path, "w");
 
-    write_plwe_poly(&key->sk, fp);
+    if (fp == NULL) {
+        printf("Error, can't open %s!\n", path);
+        return 1;
+    }
+
+    fprintf(fp, "%s %d\n", KEY_FORMAT_MAGIC, KEY_FORMAT_VERSION);
+    write_plwe_poly_small(&key->sk, fp);
     write_plwe_poly(&key->pk_a, fp);
     write_plwe_poly(&key->pk_b, fp);
 
-    fclose(fp);
+    int result = ferror(fp);
+    if (fclose(fp) != 0 || result != 0) {
+        printf("Error, can't write %s!\n", path);
+        return 1;
+    }
+
+    return 0;
 }
 
-void key_load(struct key *key, const char *path) {
+int key_load(struct key *key, const char *path) {
     FILE *fp;
     fp = fopen(path, "r");
 
-    read_plwe_poly(&key->sk, fp);
-    read_plwe_poly(&key->pk_a, fp);
-    read_plwe_poly(&key->pk_b, fp);
+    if (fp == NULL) {
+        printf("Error, can't open %s!\n", path);
+        return 1;
+    }
+
+    //Files of the legacy format start with the degree of the secret key, all others with the magic
+    char magic[sizeof(KEY_FORMAT_MAGIC)];
+    int version;
+
+    if (fscanf(fp, " %7s", magic) != 1) {
+        printf("Error, empty key file %s!\n", path);
+        fclose(fp);
+        return 1;
+    }
+
+    if (strcmp(magic, KEY_FORMAT_MAGIC) == 0) {
+        if (fscanf(fp, "%d", &version) != 1 || version != KEY_FORMAT_VERSION) {
+            printf("Error, unsupported key file version in %s!\n", path);
+            fclose(fp);
+            return 1;
+        }
+    }
+    else if (isdigit((unsigned char) magic[0])) {
+        version = KEY_FORMAT_LEGACY;
+        rewind(fp);
+    }
+    else {
+        printf("Error, %s is not a key file!\n", path);
+        fclose(fp);
+        return 1;
+    }
+
+    //Read everything before the key is touched, a failing file leaves no partially filled key
+    struct plwe_poly_small sk;
+    struct plwe_poly pk_a, pk_b;
+
+    int result = (version == KEY_FORMAT_LEGACY) ? read_plwe_poly_small_legacy(&sk, fp) : read_plwe_poly_small(&sk, fp);
+    if (result != 0) {
+        fclose(fp);
+        return 1;
+    }
+
+    if (read_plwe_poly(&pk_a, fp) != 0) {
+        plwe_poly_small_clear(&sk);
+        fclose(fp);
+        return 1;
+    }
+
+    if (read_plwe_poly(&pk_b, fp) != 0) {
+        plwe_poly_small_clear(&sk);
+        plwe_poly_clear(&pk_a);
+        fclose(fp);
+        return 1;
+    }
 
     fclose(fp);
+
+    if (sk.n != pk_a.n || sk.n != pk_b.n || !fmpz_equal(pk_a.mod, pk_b.mod)) {
+        printf("Error, key parts of %s do not match!\n", path);
+        plwe_poly_small_clear(&sk);
+        plwe_poly_clear(&pk_a);
+        plwe_poly_clear(&pk_b);
+        return 1;
+    }
+
+    key->sk = sk;
+    key->pk_a = pk_a;
+    key->pk_b = pk_b;
+
+    return 0;
 }
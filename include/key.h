@@ -4,9 +4,13 @@
 #include "util.h"
 #include "plwe_poly.h"
 
+#define KEY_FORMAT_MAGIC "PLWEKEY"
+#define KEY_FORMAT_VERSION 2        // Secret key as small polynomial
+#define KEY_FORMAT_LEGACY 1         // No header, secret key as polynomial mod q (read only)
+
 struct key {
     struct settings settings;
-    struct plwe_poly sk; //private key
+    struct plwe_poly_small sk; //private key (small coefficients)
     struct plwe_poly pk_a; //public key a
     struct plwe_poly pk_b; //public key b
 };
@@ -33,14 +37,17 @@ void key_init_eval(struct key_eval *key_eval, const struct key *key, int T);
 /// @param[in,out] key_eval Evaluation key
 void key_clear_eval(struct key_eval *key_eval);
 
-/// Save a key to a file
+/// Save a key to a file, the file starts with KEY_FORMAT_MAGIC and KEY_FORMAT_VERSION
 /// @param[in] key Key
 /// @param[in] path Filepath
-void key_save(struct key *key, const char *path);
+/// @return 0 if ok, != 0 otherwise
+int key_save(struct key *key, const char *path);
 
-/// Load a key from a file
-/// @param[out] key Empty Key
+/// Load a key from a file of the current or the legacy format, other formats and versions are rejected
+/// The settings of the key are not stored and remain unchanged
+/// @param[out] key Empty Key, unchanged if the file can't be read
 /// @param[in] path Filepath
-void key_load(struct key *key, const char *path);
+/// @return 0 if ok, != 0 otherwise
+int key_load(struct key *key, const char *path);
 
 #endif //CUSTOM_KEY_H
@@ -1,21 +1,88 @@
 #include "message.h"
 
+#include "instrument.h"
 #include "key.h"
 #include "plwe_poly.h"
 #include "util.h"
 
 #include <flint/fmpz_poly.h>
+#include <string.h>
 
 void message_init(struct message *message, const struct settings *settings) {
     message->c = (struct plwe_poly *) malloc(settings->D * sizeof(struct plwe_poly));
     message->max_len = settings->D;
     message->cIndex = 0;
+    message->seeded = 0;
 }
 
 void message_clear(struct message *message){
+    for (unsigned long i = 0; i < message->cIndex; i++) {
+        plwe_poly_clear(&message->c[i]);
+    }
+
     free(message->c);
     message->max_len = 0;
     message->cIndex = 0;
+    message->seeded = 0;
+}
+
+void message_set(struct message *result, const struct message *message) {
+    if (result == message) {
+        return;
+    }
+
+    if (message->cIndex > result->max_len) {
+        printf("Error, result message too small to hold result!\n");
+        return;
+    }
+
+    for (unsigned long i = 0; i < result->cIndex; i++) {
+        plwe_poly_clear(&result->c[i]);
+    }
+
+    for (unsigned long i = 0; i < message->cIndex; i++) {
+        plwe_poly_init(&result->c[i], message->c[i].mod, message->c[i].n);
+        plwe_poly_set(&result->c[i], &message->c[i]);
+    }
+
+    result->cIndex = message->cIndex;
+    result->seeded = message->seeded;
+    memcpy(result->seed, message->seed, SEED_SIZE);
+}
+
+void message_expand(struct message *message) {
+    if (!message->seeded) {
+        return;
+    }
+
+    //c1 = -a, a <- R_q from seed
+    rand_poly_uniform_seeded(&message->c[1], fmpz_bits(message->c[1].mod), message->seed);
+    plwe_poly_scalar_mul_si(&message->c[1], &message->c[1], -1);
+    plwe_poly_pmod(&message->c[1]);
+
+    message->seeded = 0;
+}
+
+const struct message * message_expanded(struct message *temp, const struct message *message) {
+    if (!message->seeded) {
+        return message;
+    }
+
+    temp->c = (struct plwe_poly *) malloc(message->max_len * sizeof(struct plwe_poly));
+    temp->max_len = message->max_len;
+    temp->cIndex = 0;
+    temp->seeded = 0;
+
+    message_set(temp, message);
+    message_expand(temp);
+
+    return temp;
+}
+
+void message_expanded_clear(struct message *temp, const struct message *expanded) {
+    if (expanded == temp) {
+        message_clear(temp);
+    }
 }
 
 void message_relinearize(struct message *message, struct key_eval *key_eval) {
@@ -25,6 +92,10 @@ void message_relinearize(struct message *message, struct key_eval *key_eval) {
         return;
     }
 
+    INSTRUMENT_START(timer_relinearize);
+
+    message_expand(message);
+
     //Init polys
     struct plwe_poly * c2i = malloc((key_eval->l + 1) * sizeof(struct plwe_poly));  //final polynomials used to compute c_0', c_1'
     for (unsigned long i = 0; i <= key_eval->l; i++) {
@@ -85,6 +156,82 @@ void message_relinearize(struct message *message, struct key_eval *key_eval) {
     message->cIndex -= 1;
 
     //Cleanup
+    for (unsigned long i = 0; i <= key_eval->l; i++) {
+        plwe_poly_clear(&c2i[i]);
+    }
     free(c2i);
     plwe_poly_clear(&tmp);
+
+    INSTRUMENT_STOP(timer_relinearize);
+}
+
+void message_mod_switch(struct message *message, const struct settings *settings, unsigned long level) {
+    if (level >= settings->q_chain_len) {
+        printf("Error. Level %ld is not part of the modulus chain (length %ld).\n", level, settings->q_chain_len);
+        return;
+    }
+
+    const fmpz *q_new = &settings->q_chain[level];
+
+    if (fmpz_cmp(q_new, message->c[0].mod) >= 0) {
+        printf("Doing nothing. Modulus switching requires a smaller modulus.\n");
+        return;
+    }
+
+    if (fmpz_fdiv_ui(message->c[0].mod, settings->t) != fmpz_fdiv_ui(q_new, settings->t)) {
+        printf("Error. Both moduli must be congruent mod t.\n");
+        return;
+    }
+
+    message_expand(message);
+
+    fmpz_t q_old, coeff, scaled, remainder, q_2;
+    fmpz_init_set(q_old, message->c[0].mod);  //copy, the polynomials are switched one after another
+    fmpz_init(coeff);
+    fmpz_init(scaled);
+    fmpz_init(remainder);
+    fmpz_init(q_2);
+
+    fmpz_fdiv_q_2exp(q_2, q_old, 1);
+    unsigned long t_2 = settings->t / 2;
+
+    for (unsigned long i = 0; i < message->cIndex; i++) {
+        for (signed long d = 0; d < message->c[i].n; d++) {
+            fmpz_poly_get_coeff_fmpz(coeff, message->c[i].poly, d);
+
+            //Center coefficient around 0
+            if (fmpz_cmp(coeff, q_2) > 0) {
+                fmpz_sub(coeff, coeff, q_old);
+            }
+
+            //scaled = round(coeff * q' / q)
+            fmpz_mul(scaled, coeff, q_new);
+            fmpz_fdiv_qr(scaled, remainder, scaled, q_old);
+            if (fmpz_cmp(remainder, q_2) > 0) {
+                fmpz_add_ui(scaled, scaled, 1);
+            }
+
+            //Correct scaled to the closest value with scaled = coeff mod t
+            fmpz_sub(remainder, coeff, scaled);
+            unsigned long delta = fmpz_fdiv_ui(remainder, settings->t);
+
+            if (delta > t_2) {
+                fmpz_sub_ui(scaled, scaled, settings->t - delta);
+            }
+            else {
+                fmpz_add_ui(scaled, scaled, delta);
+            }
+
+            fmpz_mod(scaled, scaled, q_new);
+            fmpz_poly_set_coeff_fmpz(message->c[i].poly, d, scaled);
+        }
+
+        fmpz_set(message->c[i].mod, q_new);
+    }
+
+    fmpz_clear(q_old);
+    fmpz_clear(coeff);
+    fmpz_clear(scaled);
+    fmpz_clear(remainder);
+    fmpz_clear(q_2);
 }
@@ -1,6 +1,8 @@
 #ifndef CUSTOM_MESSAGE_H
 #define CUSTOM_MESSAGE_H
 
+#include "util.h"
+
 //Forward declarations
 struct key_eval;    /// defined in key.h
 struct settings;    /// defined in util.h
@@ -9,6 +11,8 @@ struct message {
     struct plwe_poly *c;
     unsigned long max_len;
     unsigned long cIndex;
+    unsigned char seed[SEED_SIZE];  // Seed of c1 = -a for seeded symmetric ciphertexts
+    int seeded;                     // != 0 if c1 was not yet expanded from seed
 };
 
 /// Initialize a ciphertext
@@ -20,9 +24,39 @@ void message_init(struct message *message, const struct settings *settings);
 /// @param message[in] Ciphertext
 void message_clear(struct message *message);
 
+/// Copy a ciphertext
+/// @param result[out] Ciphertext initialized with message_init
+/// @param message[in] Ciphertext
+void message_set(struct message *result, const struct message *message);
+
+/// Expand c1 of a seeded ciphertext from its seed in place, does nothing for expanded ciphertexts
+/// Operations never write to their read-only inputs, expand explicitly (or when deserializing) before a ciphertext is read several times
+/// @param message[in,out] Ciphertext
+void message_expand(struct message *message);
+
+/// Expanded version of a read-only ciphertext, seeded ciphertexts are expanded into a temporary copy
+/// Only meant for inputs that can't be written, every call expands the seed again
+/// @param temp[out] Uninitialized storage for the copy
+/// @param message[in] Ciphertext
+/// @return message if it is expanded, temp otherwise (release with message_expanded_clear)
+const struct message * message_expanded(struct message *temp, const struct message *message);
+
+/// Release the result of message_expanded
+/// @param temp[in,out] Storage passed to message_expanded
+/// @param expanded[in] Result of message_expanded
+void message_expanded_clear(struct message *temp, const struct message *expanded);
+
 /// Relinearize a ciphertext (reduce its elements by one)
 /// @param message Ciphertext
 /// @param key_eval Evaluation Key
 void message_relinearize(struct message *message, struct key_eval *key_eval);
 
+/// Switch a ciphertext to a smaller modulus of the modulus chain
+/// Every coefficient is scaled by q'/q and rounded to the closest value congruent to the original one mod t,
+/// i.e. the plaintext is kept while the noise shrinks by q'/q
+/// @param message[in,out] Ciphertext
+/// @param settings[in] Settings containing t and the modulus chain
+/// @param level[in] Index of the target modulus in the modulus chain
+void message_mod_switch(struct message *message, const struct settings *settings, unsigned long level);
+
 #endif //CUSTOM_MESSAGE_H
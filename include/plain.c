@@ -0,0 +1,72 @@
+#include "plain.h"
+
+#include "encoding.h"
+#include "instrument.h"
+#include "util.h"
+
+#include <flint/fmpz_vec.h>
+
+void plain_init(struct plain *plain, const struct plwe_poly *poly, const struct settings *settings, enum plain_form form) {
+    plwe_poly_init(&plain->poly, settings->q, settings->n);
+    plwe_poly_set(&plain->poly, poly);
+    plwe_poly_pmod(&plain->poly);
+
+    //Keep the plaintext coefficients small (centered), the sparse kernel scales by them directly
+    _fmpz_vec_scalar_smod_fmpz(plain->poly.poly->coeffs, plain->poly.poly->coeffs, fmpz_poly_length(plain->poly.poly), settings->q);
+
+    if (form == plain_auto) {
+        form = (plwe_poly_nnz(&plain->poly) <= SPARSE_THRESHOLD) ? plain_sparse : plain_transform;
+    }
+
+    plain->form = form;
+
+    if (form == plain_transform) {
+        //Ciphertext polynomials have at most n coefficients of at most qBits bits
+        fmpz_poly_mul_SS_precache_init(plain->precache, settings->n, (signed long) settings->qBits, plain->poly.poly);
+    }
+    else if (form == plain_sparse) {
+        plwe_poly_sparse_init(&plain->sparse, &plain->poly);
+    }
+}
+
+void plain_init_si(struct plain *plain, signed long value, const struct settings *settings, enum plain_form form) {
+    struct plwe_poly poly;
+    plwe_poly_init(&poly, settings->q, settings->n);
+
+    if (settings->encoding == encoding_balanced) {
+        encode_si_balanced(&poly, value, settings->b);
+    }
+    else {
+        encode_si(&poly, value, settings->b);
+    }
+
+    plain_init(plain, &poly, settings, form);
+
+    plwe_poly_clear(&poly);
+}
+
+void plain_clear(struct plain *plain) {
+    if (plain->form == plain_transform) {
+        fmpz_poly_mul_precache_clear(plain->precache);
+    }
+    else if (plain->form == plain_sparse) {
+        plwe_poly_sparse_clear(&plain->sparse);
+    }
+
+    plwe_poly_clear(&plain->poly);
+}
+
+void plain_mul(struct plwe_poly *result, const struct plwe_poly *poly, struct plain *plain) {
+    if (plain->form == plain_transform) {
+        INSTRUMENT_COUNT(counter_ring_mul, 1);
+        fmpz_poly_mul_SS_precache(result->poly, poly->poly, plain->precache);
+    }
+    else if (plain->form == plain_sparse) {
+        plwe_poly_mul_sparse(result, poly, &plain->sparse);
+    }
+    else {
+        plwe_poly_mul(result, poly, &plain->poly);
+    }
+
+    plwe_poly_pmod(result);
+}
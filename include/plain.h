@@ -0,0 +1,51 @@
+#ifndef CUSTOM_PLAIN_H
+#define CUSTOM_PLAIN_H
+
+#include "plwe_poly.h"
+
+#include <flint/fmpz_poly.h>
+
+//Forward declarations
+struct settings;    /// defined in util.h
+
+enum plain_form {
+    plain_dense = 1,        // Multiply with the plaintext polynomial
+    plain_transform = 2,    // Multiply with the cached transform (FFT) of the plaintext
+    plain_sparse = 3,       // Multiply with the non-zero coefficients only (negacyclic shift and scale)
+    plain_auto = 4,         // Choose sparse (up to SPARSE_THRESHOLD non-zero coefficients) or transform form
+};
+
+/// Encoded plaintext, encoded once and reused for many plain operations
+struct plain {
+    struct plwe_poly poly;              // Encoded plaintext, used for additions and the dense form
+    enum plain_form form;               // Form used for multiplications
+    fmpz_poly_mul_precache_t precache;  // Transform of poly (form plain_transform)
+    struct plwe_poly_sparse sparse;     // Non-zero coefficients of poly (form plain_sparse)
+};
+
+/// Initialize an encoded plaintext from a plaintext polynomial
+/// @param[out] plain Encoded plaintext
+/// @param[in] poly Plaintext
+/// @param[in] settings Settings
+/// @param[in] form Form used for multiplications
+void plain_init(struct plain *plain, const struct plwe_poly *poly, const struct settings *settings, enum plain_form form);
+
+/// Encode a signed integer (using the encoding of the settings) and initialize an encoded plaintext
+/// @param[out] plain Encoded plaintext
+/// @param[in] value Integer
+/// @param[in] settings Settings
+/// @param[in] form Form used for multiplications
+void plain_init_si(struct plain *plain, signed long value, const struct settings *settings, enum plain_form form);
+
+/// Clear an encoded plaintext
+/// @param[in,out] plain Encoded plaintext
+void plain_clear(struct plain *plain);
+
+/// Multiply a polynomial with an encoded plaintext and reduce the result
+/// The transform form is not thread safe, FLINT uses the cache as scratch space
+/// @param[out] result Result of the multiplication
+/// @param[in] poly Polynomial, reduced mod f(x) and q
+/// @param[in] plain Encoded plaintext
+void plain_mul(struct plwe_poly *result, const struct plwe_poly *poly, struct plain *plain);
+
+#endif //CUSTOM_PLAIN_H
@@ -1,11 +1,20 @@
 #include "plwe_poly.h"
 
 #include "dist.h"
+#include "instrument.h"
 #include "util.h"
 
+#include <flint/fmpz_vec.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+
 void plwe_poly_init(struct plwe_poly *poly, const fmpz_t q, const signed long n) {
     // q = coefficient modulo
     // n = polynomial modulo f(x)
+    INSTRUMENT_COUNT(counter_poly_alloc, 1);
+
     poly->n = n;
     fmpz_init_set(poly->mod, q);
     fmpz_poly_init(poly->poly);
@@ -24,6 +33,8 @@ void plwe_poly_clear(struct plwe_poly *poly) {
 }
 
 void plwe_poly_mod_t(struct plwe_poly *poly, unsigned long t){
+    INSTRUMENT_COUNT(counter_mod_t, 1);
+
     fmpz_t coeff, q_2;
     fmpz_init(coeff);
     fmpz_init(q_2);
@@ -55,20 +66,24 @@ void plwe_poly_mod_t(struct plwe_poly *poly, unsigned long t){
 }
 
 void plwe_poly_pmod(struct plwe_poly *poly){
-    //FMod
-    fmpz_poly_rem(poly->poly, poly->poly, poly->fmod);
+    INSTRUMENT_COUNT(counter_reduction, 1);
+    INSTRUMENT_START(timer_poly_pmod);
 
-    //Qmod
-    fmpz_t coeff;
-    fmpz_init(coeff);
+    //FMod; x^n = -1, therefore fold every coefficient i >= n onto i - n with negated sign
+    //Iterate downwards so that coefficients >= 2n are folded multiple times
+    fmpz *coeffs = poly->poly->coeffs;
 
-    for (int i = 0; i <= poly->n; i++){
-        fmpz_poly_get_coeff_fmpz(coeff, poly->poly, i);
-        fmpz_mod(coeff, coeff, poly->mod);
-        fmpz_poly_set_coeff_fmpz(poly->poly, i, coeff);
+    for (signed long i = fmpz_poly_length(poly->poly) - 1; i >= poly->n; i--) {
+        fmpz_sub(coeffs + i - poly->n, coeffs + i - poly->n, coeffs + i);
     }
 
-    fmpz_clear(coeff);
+    fmpz_poly_truncate(poly->poly, poly->n);
+
+    //Qmod
+    _fmpz_vec_scalar_mod_fmpz(poly->poly->coeffs, poly->poly->coeffs, fmpz_poly_length(poly->poly), poly->mod);
+    _fmpz_poly_normalise(poly->poly);
+
+    INSTRUMENT_STOP(timer_poly_pmod);
 }
 
 inline __attribute__((always_inline)) void plwe_poly_set(struct plwe_poly *out, const struct plwe_poly *in){
@@ -83,7 +98,12 @@ inline __attribute__((always_inline)) void plwe_poly_add(struct plwe_poly *resul
 }
 
 inline __attribute__((always_inline)) void plwe_poly_mul(struct plwe_poly *result, const struct plwe_poly *poly1, const struct plwe_poly *poly2){
+    INSTRUMENT_COUNT(counter_ring_mul, 1);
+    INSTRUMENT_START(timer_poly_mul);
+
     fmpz_poly_mul(result->poly, poly1->poly, poly2->poly);
+
+    INSTRUMENT_STOP(timer_poly_mul);
 }
 
 inline __attribute__((always_inline)) void plwe_poly_scalar_mul_ui(struct plwe_poly *result, const struct plwe_poly *poly, unsigned long scalar){
@@ -107,27 +127,385 @@ void plwe_poly_print(const struct plwe_poly *poly){
     printf("---------------------------------------------------------------------\n");
 }
 
+signed long plwe_poly_nnz(const struct plwe_poly *poly) {
+    signed long nnz = 0;
+
+    for (signed long i = 0; i < fmpz_poly_length(poly->poly); i++) {
+        nnz += !fmpz_is_zero(poly->poly->coeffs + i);
+    }
+
+    return nnz;
+}
+
+void plwe_poly_sparse_init(struct plwe_poly_sparse *sparse, const struct plwe_poly *poly) {
+    struct plwe_poly reduced;
+    const struct plwe_poly *source = poly;
+
+    //The kernel requires the sparse polynomial to be reduced mod f(x) as well
+    if (fmpz_poly_length(poly->poly) > poly->n) {
+        plwe_poly_init(&reduced, poly->mod, poly->n);
+        plwe_poly_set(&reduced, poly);
+        plwe_poly_pmod(&reduced);
+        source = &reduced;
+    }
+
+    const fmpz *coeffs = source->poly->coeffs;
+
+    sparse->n = poly->n;
+    sparse->nnz = plwe_poly_nnz(source);
+    sparse->index = malloc(sparse->nnz * sizeof(signed long));
+    sparse->value = _fmpz_vec_init(sparse->nnz);
+
+    for (signed long i = 0, j = 0; i < fmpz_poly_length(source->poly); i++) {
+        if (!fmpz_is_zero(coeffs + i)) {
+            sparse->index[j] = i;
+            fmpz_set(sparse->value + j, coeffs + i);
+            j += 1;
+        }
+    }
+
+    if (source == &reduced) {
+        plwe_poly_clear(&reduced);
+    }
+}
+
+void plwe_poly_sparse_clear(struct plwe_poly_sparse *sparse) {
+    free(sparse->index);
+    _fmpz_vec_clear(sparse->value, sparse->nnz);
+    sparse->nnz = 0;
+}
+
+/// Add value * x^k * poly mod f(x) to a vector of n coefficients, poly may have any length
+/// Coefficient j lands at (j + k) mod n and changes its sign for every wrap around x^n = -1
+/// @param[in,out] out Vector of n coefficients
+/// @param[in] coeffs Coefficients of poly
+/// @param[in] len Length of poly
+/// @param[in] n Polynomial degree n used for f(x)=x^n + 1
+/// @param[in] k Shift
+/// @param[in] value Scalar, NULL for +-1
+/// @param[in] sign 1 to add, -1 to subtract
+static void negacyclic_addmul(fmpz *out, const fmpz *coeffs, signed long len, signed long n, signed long k,
+                              const fmpz *value, int sign) {
+    signed long pos = k % n;
+    sign = ((k / n) % 2 == 0) ? sign : -sign;
+
+    for (signed long j = 0; j < len; ) {
+        signed long count = FLINT_MIN(len - j, n - pos);   //coefficients until the next wrap around
+
+        if (value == NULL) {
+            if (sign > 0) {
+                _fmpz_vec_add(out + pos, out + pos, coeffs + j, count);
+            }
+            else {
+                _fmpz_vec_sub(out + pos, out + pos, coeffs + j, count);
+            }
+        }
+        else {
+            if (sign > 0) {
+                _fmpz_vec_scalar_addmul_fmpz(out + pos, coeffs + j, count, value);
+            }
+            else {
+                _fmpz_vec_scalar_submul_fmpz(out + pos, coeffs + j, count, value);
+            }
+        }
+
+        j += count;
+        pos = 0;
+        sign = -sign;
+    }
+}
+
+void plwe_poly_mul_sparse(struct plwe_poly *result, const struct plwe_poly *poly, const struct plwe_poly_sparse *sparse) {
+    INSTRUMENT_COUNT(counter_ring_mul, 1);
+
+    signed long n = poly->n;
+    signed long len = fmpz_poly_length(poly->poly);
+    const fmpz *coeffs = poly->poly->coeffs;
+
+    //Compute into a new vector, result and poly might be the same polynomial
+    fmpz *out = _fmpz_vec_init(n);
+
+    for (signed long i = 0; i < sparse->nnz; i++) {
+        negacyclic_addmul(out, coeffs, len, n, sparse->index[i], sparse->value + i, 1);
+    }
+
+    fmpz_poly_fit_length(result->poly, n);
+    _fmpz_vec_swap(result->poly->coeffs, out, n);
+    _fmpz_poly_set_length(result->poly, n);
+    _fmpz_poly_normalise(result->poly);
+
+    _fmpz_vec_clear(out, n);
+}
+
+/// Fetch a uniformly distributed random value in [0, bound)
+/// @param[in] bound Upper bound
+/// @return Random value
+static unsigned int random_below(unsigned int bound) {
+    unsigned int limit = UINT_MAX - (UINT_MAX % bound);  //reject the incomplete last interval
+    unsigned int r;
+
+    do {
+        urandom(&r, 1);
+    } while (r >= limit);
+
+    return r % bound;
+}
+
+void plwe_poly_small_init(struct plwe_poly_small *small, signed long n) {
+    INSTRUMENT_COUNT(counter_poly_alloc, 1);
+
+    small->n = n;
+    small->coeffs = calloc(n, sizeof(int16_t));
+    small->ternary = 1;
+    small->nnz = 0;
+}
+
+void plwe_poly_small_normalise(struct plwe_poly_small *small) {
+    small->ternary = 1;
+    small->nnz = 0;
+
+    for (signed long i = 0; i < small->n; i++) {
+        small->ternary &= (small->coeffs[i] >= -1 && small->coeffs[i] <= 1);
+        small->nnz += (small->coeffs[i] != 0);
+    }
+}
+
+void plwe_poly_small_clear(struct plwe_poly_small *small) {
+    small->n = 0;
+    free(small->coeffs);
+    small->coeffs = NULL;
+}
+
+void plwe_poly_small_get_poly(struct plwe_poly *poly, const struct plwe_poly_small *small) {
+    fmpz_poly_zero(poly->poly);
+    fmpz_poly_fit_length(poly->poly, small->n);
+
+    for (signed long i = 0; i < small->n; i++) {
+        fmpz_set_si(poly->poly->coeffs + i, small->coeffs[i]);
+    }
+
+    _fmpz_poly_set_length(poly->poly, small->n);
+    _fmpz_poly_normalise(poly->poly);
+    plwe_poly_pmod(poly);
+}
+
+void plwe_poly_small_print(const struct plwe_poly_small *small) {
+    printf("---------------------------------------------------------------------\n");
+    printf("n: %ld\n", small->n);
+    printf("poly:");
+    for (signed long i = 0; i < small->n; i++) {
+        printf(" %d", small->coeffs[i]);
+    }
+    printf("\n");
+    printf("---------------------------------------------------------------------\n");
+}
+
+void plwe_poly_mul_small(struct plwe_poly *result, const struct plwe_poly *poly, const struct plwe_poly_small *small) {
+    //Sparse ternary operands are cheaper as shifts, poly must be reduced for the kernel
+    if (small->ternary && small->nnz <= SPARSE_THRESHOLD && fmpz_poly_length(poly->poly) <= poly->n) {
+        plwe_poly_mul_ternary(result, poly, small);
+        return;
+    }
+
+    INSTRUMENT_COUNT(counter_ring_mul, 1);
+
+    //Small values are stored inline in fmpz, no allocation per coefficient
+    fmpz_poly_t tmp;
+    fmpz_poly_init2(tmp, small->n);
+
+    for (signed long i = 0; i < small->n; i++) {
+        fmpz_set_si(tmp->coeffs + i, small->coeffs[i]);
+    }
+
+    _fmpz_poly_set_length(tmp, small->n);
+    _fmpz_poly_normalise(tmp);
+
+    fmpz_poly_mul(result->poly, poly->poly, tmp);
+
+    fmpz_poly_clear(tmp);
+}
+
+void plwe_poly_mul_ternary(struct plwe_poly *result, const struct plwe_poly *poly, const struct plwe_poly_small *small) {
+    INSTRUMENT_COUNT(counter_ring_mul, 1);
+
+    signed long n = poly->n;
+    signed long len = fmpz_poly_length(poly->poly);
+    const fmpz *coeffs = poly->poly->coeffs;
+
+    //Compute into a new vector, result and poly might be the same polynomial
+    fmpz *out = _fmpz_vec_init(n);
+
+    for (signed long k = 0; k < small->n; k++) {
+        if (small->coeffs[k] == 0) {
+            continue;
+        }
+
+        //+-x^k * poly
+        negacyclic_addmul(out, coeffs, len, n, k, NULL, (small->coeffs[k] > 0) ? 1 : -1);
+    }
+
+    fmpz_poly_fit_length(result->poly, n);
+    _fmpz_vec_swap(result->poly->coeffs, out, n);
+    _fmpz_poly_set_length(result->poly, n);
+    _fmpz_poly_normalise(result->poly);
+
+    _fmpz_vec_clear(out, n);
+}
+
+void plwe_poly_addmul_small_ui(struct plwe_poly *result, const struct plwe_poly_small *small, unsigned long scalar) {
+    signed long len = fmpz_poly_length(result->poly);
+
+    fmpz_t coeff;
+    fmpz_init(coeff);
+
+    fmpz_poly_fit_length(result->poly, small->n);
+
+    for (signed long i = 0; i < small->n; i++) {
+        fmpz_set_si(coeff, small->coeffs[i]);
+        fmpz_addmul_ui(result->poly->coeffs + i, coeff, scalar);
+    }
+
+    fmpz_clear(coeff);
+
+    _fmpz_poly_set_length(result->poly, FLINT_MAX(len, small->n));
+    _fmpz_poly_normalise(result->poly);
+}
+
 void rand_poly_uniform(struct plwe_poly *poly, const unsigned long qBits) {
+    INSTRUMENT_START(timer_sample_uniform);
+
     mpz_t q;
     mpz_init2(q,qBits);
+    fmpz_t r;
+    fmpz_init(r);
     for(int i = 0; i <= poly->n; i++) {
         do {
             get_random(q, qBits);
         } while (mpz_cmp_ui(q, 0) == 0);
 
-        fmpz_t r;
         fmpz_set_mpz(r, q);
         fmpz_poly_set_coeff_fmpz(poly->poly,i,r);
     }
+    fmpz_clear(r);
+    mpz_clear(q);
+
+    plwe_poly_pmod(poly);
+
+    INSTRUMENT_STOP(timer_sample_uniform);
+}
+
+void rand_poly_uniform_seeded(struct plwe_poly *poly, const unsigned long qBits, const unsigned char *seed) {
+    INSTRUMENT_START(timer_sample_uniform);
+
+    unsigned long coeff_size = (qBits + 7) / 8;
+    unsigned char *data = malloc(poly->n * coeff_size);
+
+    urandom_seeded(data, poly->n * coeff_size, seed);  //Expand all coefficients at once
+
+    mpz_t q;
+    mpz_init2(q, coeff_size * 8);
+    fmpz_poly_fit_length(poly->poly, poly->n);
+
+    for (signed long i = 0; i < poly->n; i++) {
+        mpz_import(q, coeff_size, 1, 1, 0, 0, data + i * coeff_size);
+        mpz_fdiv_r_2exp(q, q, qBits);
+        fmpz_poly_set_coeff_mpz(poly->poly, i, q);
+    }
+
     mpz_clear(q);
+    free(data);
 
     plwe_poly_pmod(poly);
+
+    INSTRUMENT_STOP(timer_sample_uniform);
 }
 
 void rand_poly_gauss(struct plwe_poly *poly, const double std_dev) {
+    INSTRUMENT_START(timer_sample_gauss);
+
     for (int i = 0; i <= poly->n; i++) {
         signed long r = (signed long) dist_gauss_ziggurat(std_dev);
         fmpz_poly_set_coeff_si(poly->poly, i, r);
     }
     plwe_poly_pmod(poly);
+
+    INSTRUMENT_STOP(timer_sample_gauss);
+}
+
+int rand_poly_small_gauss(struct plwe_poly_small *small, const double std_dev) {
+    if (std_dev > SMALL_GAUSS_MAX_STD_DEV) {
+        printf("Error, standard deviation %f too large for small polynomials!\n", std_dev);
+        memset(small->coeffs, 0, small->n * sizeof(int16_t));
+        plwe_poly_small_normalise(small);
+        return 1;
+    }
+
+    INSTRUMENT_START(timer_sample_gauss);
+
+    for (signed long i = 0; i < small->n; i++) {
+        signed long r;
+
+        do {
+            r = (signed long) dist_gauss_ziggurat(std_dev);
+        } while (r > INT16_MAX || r < -INT16_MAX);  //beyond 16 std_dev, never in practice
+
+        small->coeffs[i] = (int16_t) r;
+    }
+
+    plwe_poly_small_normalise(small);
+
+    INSTRUMENT_STOP(timer_sample_gauss);
+
+    return 0;
+}
+
+void rand_poly_small_ternary(struct plwe_poly_small *small) {
+    INSTRUMENT_START(timer_sample_small);
+
+    for (signed long i = 0; i < small->n; i++) {
+        small->coeffs[i] = (int16_t) ((signed int) random_below(3) - 1);
+    }
+
+    plwe_poly_small_normalise(small);
+
+    INSTRUMENT_STOP(timer_sample_small);
+}
+
+void rand_poly_small_hamming(struct plwe_poly_small *small, unsigned long hw) {
+    INSTRUMENT_START(timer_sample_small);
+
+    signed long *positions = malloc(small->n * sizeof(signed long));
+
+    for (signed long i = 0; i < small->n; i++) {
+        positions[i] = i;
+        small->coeffs[i] = 0;
+    }
+
+    //Partial Fisher-Yates shuffle, the first hw positions get a random sign
+    for (unsigned long i = 0; i < hw && i < small->n; i++) {
+        unsigned long j = i + random_below(small->n - i);
+        signed long tmp = positions[i];
+        positions[i] = positions[j];
+        positions[j] = tmp;
+
+        small->coeffs[positions[i]] = (int16_t) (random_below(2) ? 1 : -1);
+    }
+
+    free(positions);
+
+    plwe_poly_small_normalise(small);
+
+    INSTRUMENT_STOP(timer_sample_small);
+}
+
+void rand_poly_small_secret(struct plwe_poly_small *small, const struct settings *settings) {
+    if (settings->secret_dist == secret_ternary) {
+        rand_poly_small_ternary(small);
+    }
+    else if (settings->secret_dist == secret_hamming) {
+        rand_poly_small_hamming(small, settings->hw);
+    }
+    else {
+        rand_poly_small_gauss(small, settings->std_dev);
+    }
 }
@@ -2,6 +2,13 @@
 #define CUSTOM_PLWE_POLY_H
 
 #include <flint/fmpz_poly.h>
+#include <stdint.h>
+
+//Forward declarations
+struct settings;    /// defined in util.h
+
+#define SPARSE_THRESHOLD 16     // Maximum amount of non-zero coefficients for which the sparse multiplication is faster
+#define SMALL_GAUSS_MAX_STD_DEV (INT16_MAX / 16.0)  // Samples beyond 16 std_dev (never in practice) are redrawn
 
 struct plwe_poly {
     signed long n;
@@ -10,6 +17,22 @@ struct plwe_poly {
     fmpz_poly_t poly;
 };
 
+/// Polynomial with small signed coefficients (secrets, errors), independent of the coefficient modulus
+struct plwe_poly_small {
+    signed long n;
+    int16_t *coeffs;        // n coefficients
+    int ternary;            // != 0 if all coefficients are in {-1, 0, 1}
+    signed long nnz;        // Amount of non-zero coefficients
+};
+
+/// Polynomial stored by its non-zero coefficients only (e.g. an encoded plaintext)
+struct plwe_poly_sparse {
+    signed long n;
+    signed long nnz;        // Amount of non-zero coefficients
+    signed long *index;     // Exponents of the non-zero coefficients (ascending)
+    fmpz *value;            // Non-zero coefficients
+};
+
 /// Initialize polynomial
 /// @param[out] poly Empty polynomial
 /// @param[in] q Coefficient modulus q
@@ -68,14 +91,105 @@ extern void plwe_poly_scalar_mul_mpz(struct plwe_poly *result, const struct plwe
 /// @param[in] poly Polynomial
 void plwe_poly_print(const struct plwe_poly *poly);
 
+/// Count the non-zero coefficients of a polynomial
+/// @param[in] poly Polynomial
+/// @return Amount of non-zero coefficients
+signed long plwe_poly_nnz(const struct plwe_poly *poly);
+
+/// Initialize a sparse polynomial from a polynomial
+/// @param[out] sparse Sparse polynomial
+/// @param[in] poly Polynomial
+void plwe_poly_sparse_init(struct plwe_poly_sparse *sparse, const struct plwe_poly *poly);
+
+/// Clear sparse polynomial
+/// @param[in,out] sparse Sparse polynomial
+void plwe_poly_sparse_clear(struct plwe_poly_sparse *sparse);
+
+/// Multiply a polynomial with a sparse polynomial mod f(x) in O(len * nnz)
+/// Every non-zero coefficient v*x^k adds the negacyclic shift of poly by k scaled by v, coefficients are not reduced mod q
+/// @param[out] result Result of the multiplication, may be poly
+/// @param[in] poly Polynomial of any length, coefficients of degree >= n are folded mod f(x)
+/// @param[in] sparse Sparse polynomial
+void plwe_poly_mul_sparse(struct plwe_poly *result, const struct plwe_poly *poly, const struct plwe_poly_sparse *sparse);
+
+/// Initialize small polynomial (all coefficients 0)
+/// @param[out] small Small polynomial
+/// @param[in] n Polynomial degree n used for f(x)=x^n + 1
+void plwe_poly_small_init(struct plwe_poly_small *small, signed long n);
+
+/// Clear small polynomial
+/// @param[in,out] small Small polynomial
+void plwe_poly_small_clear(struct plwe_poly_small *small);
+
+/// Convert a small polynomial to a polynomial mod q
+/// @param[out] poly Initialized polynomial
+/// @param[in] small Small polynomial
+void plwe_poly_small_get_poly(struct plwe_poly *poly, const struct plwe_poly_small *small);
+
+/// Recompute ternary and nnz after the coefficients were set directly
+/// @param[in,out] small Small polynomial
+void plwe_poly_small_normalise(struct plwe_poly_small *small);
+
+/// Print a small polynomial
+/// @param[in] small Small polynomial
+void plwe_poly_small_print(const struct plwe_poly_small *small);
+
+/// Multiply a polynomial with a small polynomial
+/// The small operand enters FLINT as word sized coefficients, its Kronecker substitution therefore packs
+/// slots of about qBits + 16 + log2(n) bits instead of 2 * qBits
+/// Sparse ternary operands (up to SPARSE_THRESHOLD non-zero coefficients) use plwe_poly_mul_ternary instead
+/// @param[out] result Result of the multiplication (congruent mod f(x), not reduced), may be poly
+/// @param[in] poly Polynomial
+/// @param[in] small Small polynomial
+void plwe_poly_mul_small(struct plwe_poly *result, const struct plwe_poly *poly, const struct plwe_poly_small *small);
+
+/// Multiply a polynomial with a ternary polynomial mod f(x) using additions and subtractions of negacyclic shifts
+/// @param[out] result Result of the multiplication, may be poly
+/// @param[in] poly Polynomial of any length, coefficients of degree >= n are folded mod f(x)
+/// @param[in] small Small polynomial with coefficients in {-1, 0, 1}
+void plwe_poly_mul_ternary(struct plwe_poly *result, const struct plwe_poly *poly, const struct plwe_poly_small *small);
+
+/// Add a small polynomial multiplied with a scalar to a polynomial (result += scalar * small)
+/// @param[in,out] result Polynomial
+/// @param[in] small Small polynomial
+/// @param[in] scalar Scalar
+void plwe_poly_addmul_small_ui(struct plwe_poly *result, const struct plwe_poly_small *small, unsigned long scalar);
+
 /// Generate a polynomial with uniformly distributed (random) coefficients
 /// @param[out] poly Polynomial
 /// @param[in] qBits Maximum bit-size of coefficients
 void rand_poly_uniform(struct plwe_poly *poly, unsigned long qBits);
 
+/// Generate a polynomial with uniformly distributed coefficients deterministically expanded from a seed
+/// @param[out] poly Polynomial
+/// @param[in] qBits Maximum bit-size of coefficients
+/// @param[in] seed Seed of size SEED_SIZE
+void rand_poly_uniform_seeded(struct plwe_poly *poly, unsigned long qBits, const unsigned char *seed);
+
 /// Generate a polynomial with gaussian distributed coefficients
 /// @param[out] poly Polynomial
 /// @param[in] std_dev Standard deviation of the gaussian distribution
 void rand_poly_gauss(struct plwe_poly *poly, double std_dev);
 
+/// Generate a small polynomial with gaussian distributed coefficients
+/// Larger deviations (e.g. greater_std_dev) do not fit the small coefficients, use rand_poly_gauss
+/// @param[out] small Small polynomial
+/// @param[in] std_dev Standard deviation of the gaussian distribution (<= SMALL_GAUSS_MAX_STD_DEV)
+/// @return 0 if ok, != 0 if std_dev is too large (small is set to zero)
+int rand_poly_small_gauss(struct plwe_poly_small *small, double std_dev);
+
+/// Generate a small polynomial with uniformly distributed coefficients in {-1, 0, 1}
+/// @param[out] small Small polynomial
+void rand_poly_small_ternary(struct plwe_poly_small *small);
+
+/// Generate a small polynomial with exactly hw coefficients in {-1, 1} at random positions
+/// @param[out] small Small polynomial
+/// @param[in] hw Hamming weight (<= n)
+void rand_poly_small_hamming(struct plwe_poly_small *small, unsigned long hw);
+
+/// Generate a small polynomial with the secret distribution of the settings
+/// @param[out] small Small polynomial
+/// @param[in] settings Settings
+void rand_poly_small_secret(struct plwe_poly_small *small, const struct settings *settings);
+
 #endif //CUSTOM_PLWE_POLY_H
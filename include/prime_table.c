@@ -0,0 +1,205 @@
+#include "prime_table.h"
+
+#include <stdio.h>
+
+/// Prime q = 1 mod 2n of a certain bit-size with a primitive 2n-th root of unity psi (psi^n = -1 mod q)
+struct prime_table_entry {
+    unsigned long n_power;      // n = 2^n_power
+    unsigned long bits;         // Bits of q
+    const char *q;              // Smallest prime >= 2^(bits - 1) with q = 1 mod 2n, decimal
+    const char *psi;            // Smallest primitive 2n-th root of unity mod q, decimal
+};
+
+//Same primes as found by generate_prime_congruent_mod_2n, i.e. a table hit and a search agree
+static const struct prime_table_entry prime_table[] = {
+    {10, 60, "576460752303439873", "409945471620803"},
+    {10, 64, "9223372036854829057", "1724910496808064"},
+    {10, 100, "633825300114114700748351660033", "519134501065844236917797462"},
+    {10, 110, "649037107316853453566312041175041", "197935969007287235203337023869"},
+    {10, 128, "170141183460469231731687303715884328961", "70243444225359303264973550629506505"},
+    {10, 200, "803469022129495137770981046170581301261101496891396417806337", "426490262359475723491337406367319251555864140044492424749"},
+    {10, 256, "57896044618658097711785492504343953926634992332820282019728792003956565221377", "42184566563573943766521382877947322279238417303309057141138490198230285007"},
+    {10, 500, "1636695303948070935006594848413799576108321023021532394741645684048066898202337277441635046162952078575443342063780035504608628272942696526664263903233", "512150135426391554669940643029595292556818917951347384916895862207973088083107374889719620533703614248933928974387954054095295601728070267817377623"},
+    {11, 60, "576460752303439873", "109511789934907"},
+    {11, 64, "9223372036854829057", "425363589952150"},
+    {11, 100, "633825300114114700748351660033", "714744821486744673939047132"},
+    {11, 110, "649037107316853453566312041418753", "587455858171840712951771418615"},
+    {11, 128, "170141183460469231731687303715884605441", "52938553961688525905147673062244005"},
+    {11, 200, "803469022129495137770981046170581301261101496891396417806337", "211958694340077808821937733505923727468627715686291210065"},
+    {11, 256, "57896044618658097711785492504343953926634992332820282019728792003956565221377", "35953989685900631699746167275000775680071517981495009093587236963449648969"},
+    {11, 500, "1636695303948070935006594848413799576108321023021532394741645684048066898202337277441635046162952078575443342063780035504608628272942696526664264589313", "533326633640140428826338215032388786988947251723600847986873768499698646172884624300530137300452171217867869611135329693798893875192997936684445178"},
+    {12, 60, "576460752303439873", "43578943963487"},
+    {12, 64, "9223372036855103489", "586436902960284"},
+    {12, 100, "633825300114114700748351660033", "411029778001658102680721774"},
+    {12, 110, "649037107316853453566312041676801", "228852659422982490782504182030"},
+    {12, 128, "170141183460469231731687303715884605441", "16584367453230952820600550652027144"},
+    {12, 200, "803469022129495137770981046170581301261101496891396417806337", "77768421390401861148874919366268953335628867794835079634"},
+    {12, 256, "57896044618658097711785492504343953926634992332820282019728792003956565221377", "19778539735601272177119568980191469958554021259609265618194673752111114907"},
+    {12, 500, "1636695303948070935006594848413799576108321023021532394741645684048066898202337277441635046162952078575443342063780035504608628272942696526664264589313", "347406474960301405247490950190661493592703324601619403957687165362900776088164487932720972848694447913769399095819781377639433620016959955903623254"},
+    {13, 60, "576460752303439873", "54612008597396"},
+    {13, 64, "9223372036855103489", "1088071884795918"},
+    {13, 100, "633825300114114700748353503233", "4957255540441504202829804"},
+    {13, 110, "649037107316853453566312041676801", "6296354776349787260265865599"},
+    {13, 128, "170141183460469231731687303715885006849", "5122187552189786754440741740392754"},
+    {13, 200, "803469022129495137770981046170581301261101496891396418404353", "105704160757929314912763570055495984011917801143406676604"},
+    {13, 256, "57896044618658097711785492504343953926634992332820282019728792003956565524481", "1234195601105377284981401582389853293757289849777329431100312472904952401"},
+    {13, 500, "1636695303948070935006594848413799576108321023021532394741645684048066898202337277441635046162952078575443342063780035504608628272942696526664266711041", "28279803883971102316181687828800757833356742044473112036905005309837738617489203958120489453621581239502974659966012870326831434962463860164524435"},
+    {14, 60, "576460752304439297", "8242615629351"},
+    {14, 64, "9223372036855103489", "516589893248473"},
+    {14, 100, "633825300114114700748353503233", "21083728508923924930502837"},
+    {14, 110, "649037107316853453566312041676801", "2459075007572901417896885606"},
+    {14, 128, "170141183460469231731687303715885907969", "4059997268893838891974552256568561"},
+    {14, 200, "803469022129495137770981046170581301261101496891396418404353", "75040914290658896610280707024920738597627359292567094449"},
+    {14, 256, "57896044618658097711785492504343953926634992332820282019728792003956566065153", "1694698873168039739263265069795310224180270837294835237541178778096024200"},
+    {14, 500, "1636695303948070935006594848413799576108321023021532394741645684048066898202337277441635046162952078575443342063780035504608628272942696526664266711041", "66730486073337467896358758370100357829399336995753294700389404608591136836425643473793839390867571238029001617988774750071482029330534331165040790"},
+    {15, 60, "576460752308273153", "16141297350887"},
+    {15, 64, "9223372036855103489", "16127202283327"},
+    {15, 100, "633825300114114700748353503233", "2661469510521550373060222"},
+    {15, 110, "649037107316853453566312041676801", "24734916775030360498214176726"},
+    {15, 128, "170141183460469231731687303715887185921", "2653772661613900915638402247135372"},
+    {15, 200, "803469022129495137770981046170581301261101496891396420468737", "23266503469518798773112853548139683858346320988091389000"},
+    {15, 256, "57896044618658097711785492504343953926634992332820282019728792003956566065153", "148504215331350571729687796435403033633872010078076752028980828197952505"},
+    {15, 500, "1636695303948070935006594848413799576108321023021532394741645684048066898202337277441635046162952078575443342063780035504608628272942696526664271986689", "207761470469044974792486804020599932005261503092219541013103600525119635672771966174771786661396356039523818686511796481467880898411329485849292385"},
+};
+#define PRIME_TABLE_LEN (sizeof(prime_table) / sizeof(prime_table[0]))
+
+//Largest primes < 2^60 with q = 1 mod 2n, descending
+static const unsigned long chain_10_moduli[] = {
+        1152921504606830593UL, 1152921504606791681UL, 1152921504606748673UL, 1152921504606683137UL,
+        1152921504606631937UL, 1152921504606601217UL, 1152921504606588929UL, 1152921504606584833UL
+};
+static const unsigned long chain_10_psi[] = {
+        340790403141058UL, 428760652242482UL, 994850482975162UL, 433140431212744UL,
+        1721737924286075UL, 1641045099146827UL, 631976035845796UL, 1801500892998170UL
+};
+static const unsigned long chain_11_moduli[] = {
+        1152921504606830593UL, 1152921504606748673UL, 1152921504606683137UL, 1152921504606601217UL,
+        1152921504606588929UL, 1152921504606584833UL, 1152921504606515201UL, 1152921504606441473UL
+};
+static const unsigned long chain_11_psi[] = {
+        459811883340678UL, 274238227749925UL, 1156363531506682UL, 44176577323581UL,
+        1441026171466961UL, 1069323063926511UL, 759531000945006UL, 3227066032003032UL
+};
+static const unsigned long chain_12_moduli[] = {
+        1152921504606830593UL, 1152921504606748673UL, 1152921504606683137UL, 1152921504606601217UL,
+        1152921504606584833UL, 1152921504606109697UL, 1152921504605962241UL, 1152921504605913089UL
+};
+static const unsigned long chain_12_psi[] = {
+        116777451583545UL, 271802498405390UL, 134367042585739UL, 276147373136904UL,
+        317490233586139UL, 279138086580908UL, 301533500940835UL, 389802915667920UL
+};
+static const unsigned long chain_13_moduli[] = {
+        1152921504606830593UL, 1152921504606748673UL, 1152921504606683137UL, 1152921504606601217UL,
+        1152921504606584833UL, 1152921504606109697UL, 1152921504605962241UL, 1152921504605913089UL
+};
+static const unsigned long chain_13_psi[] = {
+        25959043411404UL, 100406242475323UL, 45474351589225UL, 92707844590835UL,
+        23981819781494UL, 253932030982881UL, 64984728504994UL, 27694533958986UL
+};
+static const unsigned long chain_14_moduli[] = {
+        1152921504606748673UL, 1152921504606683137UL, 1152921504606584833UL, 1152921504605962241UL,
+        1152921504604979201UL, 1152921504600260609UL, 1152921504599080961UL, 1152921504598720513UL
+};
+static const unsigned long chain_14_psi[] = {
+        62213374832584UL, 212089012217363UL, 92166579128688UL, 74756755228070UL,
+        52069629205452UL, 27543819356734UL, 92056553354496UL, 89492317149395UL
+};
+static const unsigned long chain_15_moduli[] = {
+        1152921504606584833UL, 1152921504598720513UL, 1152921504597016577UL, 1152921504595968001UL,
+        1152921504595640321UL, 1152921504593412097UL, 1152921504592822273UL, 1152921504592429057UL
+};
+static const unsigned long chain_15_psi[] = {
+        4443670208963UL, 100545759574150UL, 31693996050849UL, 88651361085495UL,
+        9679305630873UL, 24428769072221UL, 18776242964106UL, 5821397352863UL
+};
+
+static const struct prime_chain prime_chains[] = {
+    {10, PRIME_CHAIN_LEN, chain_10_moduli, chain_10_psi},
+    {11, PRIME_CHAIN_LEN, chain_11_moduli, chain_11_psi},
+    {12, PRIME_CHAIN_LEN, chain_12_moduli, chain_12_psi},
+    {13, PRIME_CHAIN_LEN, chain_13_moduli, chain_13_psi},
+    {14, PRIME_CHAIN_LEN, chain_14_moduli, chain_14_psi},
+    {15, PRIME_CHAIN_LEN, chain_15_moduli, chain_15_psi},
+};
+#define PRIME_CHAINS_LEN (sizeof(prime_chains) / sizeof(prime_chains[0]))
+
+/// Check a prime q = 1 mod 2n and a primitive 2n-th root of unity psi
+/// @return 0 if ok, != 0 otherwise
+static int check_prime(const fmpz_t q, const fmpz_t psi, unsigned long n_power) {
+    fmpz_t power, minus_one;
+    fmpz_init(power);
+    fmpz_init(minus_one);
+
+    //psi^n = -1 implies psi^2n = 1 and psi^k != 1 for all k < 2n, as 2n is a power of two
+    fmpz_sub_ui(minus_one, q, 1);
+    fmpz_setbit(power, n_power);
+    fmpz_powm(power, psi, power, q);
+
+    int ret = !fmpz_is_probabprime(q) || fmpz_fdiv_ui(q, 2UL << n_power) != 1 || !fmpz_equal(power, minus_one);
+
+    fmpz_clear(power);
+    fmpz_clear(minus_one);
+
+    return ret;
+}
+
+int prime_table_lookup(fmpz_t q, fmpz_t psi, unsigned long n_power, unsigned long bits) {
+    for (unsigned long i = 0; i < PRIME_TABLE_LEN; i++) {
+        if (prime_table[i].n_power == n_power && prime_table[i].bits == bits) {
+            fmpz_set_str(q, prime_table[i].q, 10);
+            if (psi != NULL) {
+                fmpz_set_str(psi, prime_table[i].psi, 10);
+            }
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+const struct prime_chain * prime_table_chain(unsigned long n_power) {
+    for (unsigned long i = 0; i < PRIME_CHAINS_LEN; i++) {
+        if (prime_chains[i].n_power == n_power) {
+            return &prime_chains[i];
+        }
+    }
+
+    return NULL;
+}
+
+int prime_table_verify(void) {
+    int failed = 0;
+    fmpz_t q, psi;
+    fmpz_init(q);
+    fmpz_init(psi);
+
+    for (unsigned long i = 0; i < PRIME_TABLE_LEN; i++) {
+        fmpz_set_str(q, prime_table[i].q, 10);
+        fmpz_set_str(psi, prime_table[i].psi, 10);
+
+        if (check_prime(q, psi, prime_table[i].n_power) || fmpz_sizeinbase(q, 2) != prime_table[i].bits) {
+            printf("Prime table: invalid entry n = 2^%lu, %lu bits\n", prime_table[i].n_power, prime_table[i].bits);
+            failed++;
+        }
+    }
+
+    for (unsigned long i = 0; i < PRIME_CHAINS_LEN; i++) {
+        const struct prime_chain *chain = &prime_chains[i];
+
+        for (unsigned long j = 0; j < chain->length; j++) {
+            fmpz_set_ui(q, chain->moduli[j]);
+            fmpz_set_ui(psi, chain->psi[j]);
+
+            if (check_prime(q, psi, chain->n_power) || fmpz_sizeinbase(q, 2) > PRIME_CHAIN_BITS ||
+                (j > 0 && chain->moduli[j] >= chain->moduli[j - 1])) {
+                printf("Prime table: invalid chain modulus n = 2^%lu, index %lu\n", chain->n_power, j);
+                failed++;
+            }
+        }
+    }
+
+    fmpz_clear(q);
+    fmpz_clear(psi);
+
+    return failed;
+}
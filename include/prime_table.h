@@ -0,0 +1,37 @@
+#ifndef CUSTOM_PRIME_TABLE_H
+#define CUSTOM_PRIME_TABLE_H
+
+#include <flint/fmpz.h>
+
+#define PRIME_CHAIN_LEN 8           // Moduli of every RNS chain
+#define PRIME_CHAIN_BITS 60         // Moduli of the RNS chains are < 2^PRIME_CHAIN_BITS (fit a word with headroom)
+
+/// Chain of word-sized primes q_i = 1 mod 2n for a residue number system, with primitive 2n-th roots of unity
+struct prime_chain {
+    unsigned long n_power;          // n = 2^n_power
+    unsigned long length;           // Amount of moduli
+    const unsigned long *moduli;    // Primes q_0 > q_1 > ... < 2^PRIME_CHAIN_BITS
+    const unsigned long *psi;       // psi[i]^n = -1 mod q_i
+};
+
+/// Look up a precomputed prime q = 1 mod 2n of a certain bit-size
+/// The table covers n = 2^10 to 2^15 and 60, 64, 100, 110, 128, 200, 256 and 500 bits, q is the prime
+/// generate_prime_congruent_mod_2n would find
+/// @param[out] q Initialized integer to take the prime
+/// @param[out] psi Initialized integer to take the smallest primitive 2n-th root of unity mod q, or NULL
+/// @param[in] n_power Power of n
+/// @param[in] bits Bit size of q
+/// @return 0 if found, != 0 if the table has no such prime (q and psi are unchanged)
+int prime_table_lookup(fmpz_t q, fmpz_t psi, unsigned long n_power, unsigned long bits);
+
+/// Look up a precomputed RNS chain of PRIME_CHAIN_LEN word-sized primes q_i = 1 mod 2n
+/// @param[in] n_power Power of n (10 to 15)
+/// @return Chain, NULL if the table has no chain for n
+const struct prime_chain * prime_table_chain(unsigned long n_power);
+
+/// Check all table entries and chains: q prime, q = 1 mod 2n, bit-size and psi^n = -1 mod q
+/// Prints every failing entry
+/// @return Amount of failing entries, 0 if ok
+int prime_table_verify(void);
+
+#endif //CUSTOM_PRIME_TABLE_H
@@ -0,0 +1,262 @@
+#include "primes.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PRIME_PARALLEL_BITS 256     // Smaller primes are found faster than threads are started
+#define PRIME_REPS 25               // Miller-Rabin repetitions of mpz_probab_prime_p
+#define PRIME_CACHE_MAX_GAP 16      // Cached primes must be < start + modulus * PRIME_CACHE_MAX_GAP * bits, the
+                                    // expected distance is about modulus * ln(start) / 2 for even moduli
+
+struct prime_cache_entry {
+    mpz_t start;
+    unsigned long modulus;
+    mpz_t prime;
+};
+
+//Entries of the cache file, loaded on first use and protected by cache_lock
+static pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct prime_cache_entry *cache = NULL;
+static unsigned long cache_len = 0;
+static unsigned long cache_capacity = 0;
+static const char *cache_path = NULL;       // NULL if the cache is disabled
+
+struct prime_search_args {
+    mpz_srcptr first;               // First candidate, k = 0
+    unsigned long modulus;
+    unsigned long offset;           // First k of this thread
+    unsigned long stride;           // Amount of threads
+    atomic_ulong *found;            // Smallest k of a prime found so far, ULONG_MAX if none
+};
+
+/// Set the prime of (start, modulus), an existing entry is overwritten
+/// @return 1 if an entry was overwritten, 0 if a new entry was added
+static int cache_put(const mpz_t start, unsigned long modulus, const mpz_t prime) {
+    for (unsigned long i = 0; i < cache_len; i++) {
+        if (cache[i].modulus == modulus && mpz_cmp(cache[i].start, start) == 0) {
+            mpz_set(cache[i].prime, prime);
+            return 1;
+        }
+    }
+
+    if (cache_len == cache_capacity) {
+        cache_capacity = (cache_capacity == 0) ? 16 : 2 * cache_capacity;
+        cache = realloc(cache, cache_capacity * sizeof(struct prime_cache_entry));
+    }
+
+    mpz_init_set(cache[cache_len].start, start);
+    cache[cache_len].modulus = modulus;
+    mpz_init_set(cache[cache_len].prime, prime);
+    cache_len++;
+
+    return 0;
+}
+
+static void cache_write_entry(FILE *fp, const mpz_t start, unsigned long modulus, const mpz_t prime) {
+    mpz_out_str(fp, 16, start);
+    fprintf(fp, " %lu ", modulus);
+    mpz_out_str(fp, 16, prime);
+    fprintf(fp, "\n");
+}
+
+/// Read the cache file, lines "start modulus prime" with start and prime in hexadecimal
+/// Later lines of the same (start, modulus) win, they replace entries that failed verification
+static void cache_load(void) {
+    cache_path = getenv(PRIME_CACHE_ENV);
+    if (cache_path != NULL && cache_path[0] == '\0') {
+        cache_path = NULL;
+    }
+    if (cache_path == NULL) {
+        return;
+    }
+
+    FILE *fp = fopen(cache_path, "r");
+    if (fp == NULL) {
+        //No primes cached yet
+        return;
+    }
+
+    mpz_t start, prime;
+    unsigned long modulus;
+    mpz_init(start);
+    mpz_init(prime);
+
+    while (mpz_inp_str(start, fp, 16) != 0 && fscanf(fp, "%lu", &modulus) == 1 && mpz_inp_str(prime, fp, 16) != 0) {
+        cache_put(start, modulus, prime);
+    }
+
+    mpz_clear(start);
+    mpz_clear(prime);
+    fclose(fp);
+}
+
+/// Check a cached prime, the file might have been edited or written by another version
+/// @return 1 if prime is a prime = 1 mod modulus of the bit-size of start and close above start, 0 otherwise
+static int cache_verify(const mpz_t prime, const mpz_t start, unsigned long modulus) {
+    size_t bits = mpz_sizeinbase(start, 2);
+
+    if (mpz_cmp(prime, start) < 0 || mpz_sizeinbase(prime, 2) != bits || mpz_fdiv_ui(prime, modulus) != 1 % modulus) {
+        return 0;
+    }
+
+    //prime - start < modulus * PRIME_CACHE_MAX_GAP * bits
+    mpz_t gap, bound;
+    mpz_init(gap);
+    mpz_init_set_ui(bound, modulus);
+    mpz_sub(gap, prime, start);
+    mpz_mul_ui(bound, bound, PRIME_CACHE_MAX_GAP * bits);
+
+    int close = mpz_cmp(gap, bound) < 0;
+
+    mpz_clear(gap);
+    mpz_clear(bound);
+
+    return close && mpz_probab_prime_p(prime, PRIME_REPS) != 0;
+}
+
+/// Look up a prime, entries are verified before use
+/// @return 1 if found, 0 otherwise
+static int cache_find(mpz_t prime, const mpz_t start, unsigned long modulus) {
+    int found = 0;
+
+    pthread_mutex_lock(&cache_lock);
+    for (unsigned long i = 0; i < cache_len && found == 0; i++) {
+        if (cache[i].modulus == modulus && mpz_cmp(cache[i].start, start) == 0) {
+            mpz_set(prime, cache[i].prime);
+            found = 1;
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    return found && cache_verify(prime, start, modulus);
+}
+
+/// Store a prime, a new entry is appended to the file, an overwritten entry rewrites the whole file
+static void cache_store(const mpz_t start, unsigned long modulus, const mpz_t prime) {
+    pthread_mutex_lock(&cache_lock);
+
+    if (cache_put(start, modulus, prime) == 0) {
+        FILE *fp = fopen(cache_path, "a");
+        if (fp != NULL) {
+            cache_write_entry(fp, start, modulus, prime);
+            fclose(fp);
+        }
+    }
+    else {
+        //Write a temporary file and replace the cache at once, readers never see a partial file
+        size_t length = strlen(cache_path) + sizeof(".tmp");
+        char *tmp_path = malloc(length);
+        snprintf(tmp_path, length, "%s.tmp", cache_path);
+
+        FILE *fp = fopen(tmp_path, "w");
+        if (fp != NULL) {
+            for (unsigned long i = 0; i < cache_len; i++) {
+                cache_write_entry(fp, cache[i].start, cache[i].modulus, cache[i].prime);
+            }
+
+            if (fclose(fp) == 0) {
+                rename(tmp_path, cache_path);
+            }
+            else {
+                remove(tmp_path);
+            }
+        }
+
+        free(tmp_path);
+    }
+
+    pthread_mutex_unlock(&cache_lock);
+}
+
+/// Test the candidates first + k * modulus for k = offset, offset + stride, ... until a prime is found or k passes
+/// the smallest k found by any thread; the first prime of a thread is its smallest
+static void * prime_search_thread(void *arg) {
+    struct prime_search_args *args = arg;
+    mpz_t candidate, step;
+    mpz_init(candidate);
+    mpz_init(step);
+
+    mpz_set_ui(step, args->modulus);
+    mpz_addmul_ui(candidate, step, args->offset);
+    mpz_add(candidate, candidate, args->first);
+    mpz_mul_ui(step, step, args->stride);
+
+    for (unsigned long k = args->offset; k < atomic_load(args->found); k += args->stride) {
+        if (mpz_probab_prime_p(candidate, PRIME_REPS) != 0) {
+            unsigned long found = atomic_load(args->found);
+            while (k < found && !atomic_compare_exchange_weak(args->found, &found, k)) {
+            }
+            break;
+        }
+
+        mpz_add(candidate, candidate, step);
+    }
+
+    mpz_clear(candidate);
+    mpz_clear(step);
+
+    return NULL;
+}
+
+void prime_search_congruent(mpz_t prime, const mpz_t start, unsigned long modulus) {
+    pthread_once(&cache_once, cache_load);
+
+    if (cache_path != NULL && cache_find(prime, start, modulus)) {
+        return;
+    }
+
+    //First candidate k * modulus + 1 >= start
+    mpz_t first;
+    mpz_init(first);
+    mpz_sub_ui(first, start, 1);
+    mpz_cdiv_q_ui(first, first, modulus);
+    mpz_mul_ui(first, first, modulus);
+    mpz_add_ui(first, first, 1);
+
+    unsigned long n_threads = 1;
+    if (mpz_sizeinbase(start, 2) >= PRIME_PARALLEL_BITS) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = (online > 0) ? (unsigned long) online : 1;
+    }
+
+    atomic_ulong found;
+    atomic_init(&found, (unsigned long) -1);
+
+    struct prime_search_args *args = malloc(n_threads * sizeof(struct prime_search_args));
+    pthread_t *threads = malloc(n_threads * sizeof(pthread_t));
+
+    for (unsigned long i = 0; i < n_threads; i++) {
+        args[i].first = first;
+        args[i].modulus = modulus;
+        args[i].offset = i;
+        args[i].stride = n_threads;
+        args[i].found = &found;
+    }
+
+    //The calling thread takes the first share
+    for (unsigned long i = 1; i < n_threads; i++) {
+        pthread_create(&threads[i], NULL, prime_search_thread, &args[i]);
+    }
+    prime_search_thread(&args[0]);
+    for (unsigned long i = 1; i < n_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    //prime = first + k * modulus
+    mpz_set(prime, first);
+    mpz_set_ui(first, modulus);
+    mpz_addmul_ui(prime, first, atomic_load(&found));
+
+    if (cache_path != NULL) {
+        cache_store(start, modulus, prime);
+    }
+
+    free(args);
+    free(threads);
+    mpz_clear(first);
+}
@@ -0,0 +1,17 @@
+#ifndef CUSTOM_PRIMES_H
+#define CUSTOM_PRIMES_H
+
+#include <gmp.h>
+
+#define PRIME_CACHE_ENV "PLWE_PRIME_CACHE"          // Path of the prime cache, the cache is disabled if not set or empty
+
+/// Find the smallest prime p >= start with p = 1 mod modulus (e.g. modulus = 2n for NTT-friendly moduli)
+/// Only the candidates k * modulus + 1 are tested, in parallel for large primes; the result does not depend on
+/// the amount of threads. If PRIME_CACHE_ENV names a file, results are stored there keyed by (start, modulus) and
+/// reused by later runs; cached primes are verified and replaced if they fail
+/// @param[out] prime Initialized integer to take the prime
+/// @param[in] start Lower bound
+/// @param[in] modulus Modulus of the congruence (> 0)
+void prime_search_congruent(mpz_t prime, const mpz_t start, unsigned long modulus);
+
+#endif //CUSTOM_PRIMES_H
@@ -0,0 +1,439 @@
+#include "serialize.h"
+
+#include "message.h"
+#include "plwe_poly.h"
+#include "util.h"
+
+#include <flint/fmpz_poly.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LIMB_BITS 64
+
+/// Bit stream over a list of buffers
+struct iov_stream {
+    const struct iovec *iov;
+    int iovcnt;
+    int index;              // Current buffer
+    size_t offset;          // Offset in the current buffer
+    uint64_t bits;          // Pending bits (LSB first)
+    unsigned int nbits;     // Amount of pending bits
+    int error;              // != 0 if the buffers were too small
+};
+
+static void stream_init(struct iov_stream *stream, const struct iovec *iov, int iovcnt) {
+    stream->iov = iov;
+    stream->iovcnt = iovcnt;
+    stream->index = 0;
+    stream->offset = 0;
+    stream->bits = 0;
+    stream->nbits = 0;
+    stream->error = 0;
+}
+
+/// Get the next byte position of the stream, skip full or empty buffers
+/// @return Pointer to the byte or NULL if all buffers are exhausted
+static unsigned char * stream_next(struct iov_stream *stream) {
+    while (stream->index < stream->iovcnt && stream->offset >= stream->iov[stream->index].iov_len) {
+        stream->index += 1;
+        stream->offset = 0;
+    }
+
+    if (stream->index >= stream->iovcnt) {
+        stream->error = 1;
+        return NULL;
+    }
+
+    return (unsigned char *) stream->iov[stream->index].iov_base + stream->offset++;
+}
+
+/// Write up to 32 bits
+static void stream_write(struct iov_stream *stream, uint64_t value, unsigned int count) {
+    stream->bits |= (value & ((1ULL << count) - 1)) << stream->nbits;
+    stream->nbits += count;
+
+    while (stream->nbits >= 8) {
+        unsigned char *byte = stream_next(stream);
+        if (byte == NULL) {
+            return;
+        }
+
+        *byte = (unsigned char) stream->bits;
+        stream->bits >>= 8;
+        stream->nbits -= 8;
+    }
+}
+
+/// Write pending bits, pad the last byte with zeros
+static void stream_flush(struct iov_stream *stream) {
+    if (stream->nbits > 0) {
+        stream_write(stream, 0, 8 - stream->nbits);
+    }
+}
+
+/// Skip the padding bits of the last read byte
+static void stream_align(struct iov_stream *stream) {
+    stream->bits = 0;
+    stream->nbits = 0;
+}
+
+/// Read up to 32 bits
+static uint64_t stream_read(struct iov_stream *stream, unsigned int count) {
+    while (stream->nbits < count) {
+        unsigned char *byte = stream_next(stream);
+        if (byte == NULL) {
+            return 0;
+        }
+
+        stream->bits |= (uint64_t) *byte << stream->nbits;
+        stream->nbits += 8;
+    }
+
+    uint64_t value = stream->bits & ((1ULL << count) - 1);
+    stream->bits >>= count;
+    stream->nbits -= count;
+
+    return value;
+}
+
+/// Write a number of limbs with bits bits in total
+static void stream_write_limbs(struct iov_stream *stream, const ulong *limbs, unsigned long bits) {
+    for (unsigned long i = 0; bits > 0; i++) {
+        unsigned int low = bits < 32 ? bits : 32;
+        stream_write(stream, limbs[i] & 0xFFFFFFFFULL, low);
+        bits -= low;
+
+        unsigned int high = bits < 32 ? bits : 32;
+        stream_write(stream, limbs[i] >> 32, high);
+        bits -= high;
+    }
+}
+
+/// Read a number of limbs with bits bits in total
+static void stream_read_limbs(struct iov_stream *stream, ulong *limbs, unsigned long bits) {
+    for (unsigned long i = 0; bits > 0; i++) {
+        unsigned int low = bits < 32 ? bits : 32;
+        limbs[i] = stream_read(stream, low);
+        bits -= low;
+
+        unsigned int high = bits < 32 ? bits : 32;
+        limbs[i] |= stream_read(stream, high) << 32;
+        bits -= high;
+    }
+}
+
+/// Compute the ring parameters id (FNV-1a hash of n and q)
+/// @param[in] q Coefficient modulus q
+/// @param[in] n Polynomial degree n
+/// @return Ring parameters id
+static uint64_t ring_id(const fmpz_t q, signed long n) {
+    uint64_t hash = 14695981039346656037ULL;
+    unsigned long limb_count = (fmpz_bits(q) + LIMB_BITS - 1) / LIMB_BITS;
+    ulong limbs[limb_count + 1];
+
+    limbs[limb_count] = (ulong) n;
+    fmpz_get_ui_array(limbs, (signed long) limb_count, q);
+
+    for (unsigned long i = 0; i <= limb_count; i++) {
+        for (int j = 0; j < 8; j++) {
+            hash ^= (limbs[i] >> (8 * j)) & 0xFF;
+            hash *= 1099511628211ULL;
+        }
+    }
+
+    return hash;
+}
+
+size_t message_serialized_size(const struct message *message) {
+    if (message->seeded) {
+        size_t coeff_bits = (size_t) message->c[0].n * fmpz_bits(message->c[0].mod);
+        return MESSAGE_HEADER_SIZE + (coeff_bits + 7) / 8 + SEED_SIZE;
+    }
+
+    size_t coeff_bits = (size_t) message->cIndex * message->c[0].n * fmpz_bits(message->c[0].mod);
+    return MESSAGE_HEADER_SIZE + (coeff_bits + 7) / 8;
+}
+
+int message_serialize_iov(const struct message *message, const struct iovec *iov, int iovcnt) {
+    if (message->cIndex == 0) {
+        return serialize_invalid_format;
+    }
+
+    size_t available = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        available += iov[i].iov_len;
+    }
+
+    if (available < message_serialized_size(message)) {
+        return serialize_buffer_too_small;
+    }
+
+    const fmpz *q = message->c[0].mod;
+    signed long n = message->c[0].n;
+    unsigned long qBits = fmpz_bits(q);
+    unsigned long limb_count = (qBits + LIMB_BITS - 1) / LIMB_BITS;
+    ulong limbs[limb_count];
+
+    struct iov_stream stream;
+    stream_init(&stream, iov, iovcnt);
+
+    //Header
+    for (int i = 0; i < 4; i++) {
+        stream_write(&stream, (unsigned char) MESSAGE_FORMAT_MAGIC[i], 8);
+    }
+    stream_write(&stream, MESSAGE_FORMAT_VERSION, 16);
+    stream_write(&stream, message->seeded ? MESSAGE_FLAG_SEEDED : 0, 16);
+    stream_write(&stream, message->cIndex, 32);
+    stream_write(&stream, message->max_len, 32);
+    stream_write(&stream, (uint64_t) n, 32);
+    stream_write(&stream, qBits, 32);
+
+    uint64_t id = ring_id(q, n);
+    stream_write(&stream, id & 0xFFFFFFFFULL, 32);
+    stream_write(&stream, id >> 32, 32);
+
+    //Coefficients
+    struct plwe_poly reduced;
+    fmpz_t coeff;
+    fmpz_init(coeff);
+
+    //Seeded ciphertexts only store c0
+    unsigned long poly_count = message->seeded ? 1 : message->cIndex;
+
+    for (unsigned long i = 0; i < poly_count; i++) {
+        const struct plwe_poly *poly = &message->c[i];
+
+        //Plain operations do not reduce their result, reduce a copy
+        if (fmpz_poly_length(poly->poly) > n) {
+            plwe_poly_init(&reduced, q, n);
+            plwe_poly_set(&reduced, poly);
+            plwe_poly_pmod(&reduced);
+            poly = &reduced;
+        }
+
+        for (signed long d = 0; d < n; d++) {
+            fmpz_poly_get_coeff_fmpz(coeff, poly->poly, d);
+
+            if (fmpz_sgn(coeff) < 0 || fmpz_cmp(coeff, q) >= 0) {
+                fmpz_mod(coeff, coeff, q);
+            }
+
+            fmpz_get_ui_array(limbs, (signed long) limb_count, coeff);
+            stream_write_limbs(&stream, limbs, qBits);
+        }
+
+        if (poly == &reduced) {
+            plwe_poly_clear(&reduced);
+        }
+    }
+
+    fmpz_clear(coeff);
+
+    stream_flush(&stream);
+
+    if (message->seeded) {
+        for (int i = 0; i < SEED_SIZE; i++) {
+            stream_write(&stream, message->seed[i], 8);
+        }
+    }
+
+    return stream.error ? serialize_buffer_too_small : serialize_ok;
+}
+
+int message_serialize(const struct message *message, void *buffer, size_t size) {
+    struct iovec iov = {.iov_base = buffer, .iov_len = size};
+    return message_serialize_iov(message, &iov, 1);
+}
+
+int message_deserialize_iov(struct message *message, const struct settings *settings, const struct iovec *iov, int iovcnt,
+                            int expand) {
+    struct iov_stream stream;
+    stream_init(&stream, iov, iovcnt);
+
+    //Header
+    for (int i = 0; i < 4; i++) {
+        if (stream_read(&stream, 8) != (unsigned char) MESSAGE_FORMAT_MAGIC[i]) {
+            return stream.error ? serialize_buffer_too_small : serialize_invalid_format;
+        }
+    }
+
+    uint64_t version = stream_read(&stream, 16);
+    uint64_t flags = stream_read(&stream, 16);
+    unsigned long cIndex = stream_read(&stream, 32);
+    stream_read(&stream, 32);                                       //max_len, the message keeps its own
+    signed long n = (signed long) stream_read(&stream, 32);
+    unsigned long qBits = stream_read(&stream, 32);
+    uint64_t id = stream_read(&stream, 32);
+    id |= stream_read(&stream, 32) << 32;
+
+    if (stream.error) {
+        return serialize_buffer_too_small;
+    }
+
+    int seeded = (flags & MESSAGE_FLAG_SEEDED) != 0;
+
+    if (version != MESSAGE_FORMAT_VERSION || (flags & ~MESSAGE_FLAG_SEEDED) != 0 || cIndex == 0 || (seeded && cIndex != 2)) {
+        return serialize_invalid_format;
+    }
+
+    //Find the modulus in the modulus chain
+    const fmpz *q = NULL;
+
+    if (n == settings->n && qBits == fmpz_bits(settings->q) && ring_id(settings->q, n) == id) {
+        q = settings->q;
+    }
+
+    for (unsigned long i = 1; q == NULL && i < settings->q_chain_len; i++) {
+        if (n == settings->n && qBits == fmpz_bits(&settings->q_chain[i]) && ring_id(&settings->q_chain[i], n) == id) {
+            q = &settings->q_chain[i];
+        }
+    }
+
+    if (q == NULL) {
+        return serialize_unknown_ring;
+    }
+
+    if (cIndex > message->max_len) {
+        return serialize_message_too_small;
+    }
+
+    //Decode into new allocated memory, the message is only replaced once the whole input is valid
+    struct plwe_poly *ptr = (struct plwe_poly *) malloc(cIndex * sizeof(struct plwe_poly));
+    unsigned char seed[SEED_SIZE];
+    int status = serialize_ok;
+
+    for (unsigned long i = 0; i < cIndex; i++) {
+        plwe_poly_init(&ptr[i], q, n);
+    }
+
+    //Coefficients, read directly into the coefficient storage
+    unsigned long limb_count = (qBits + LIMB_BITS - 1) / LIMB_BITS;
+    ulong limbs[limb_count];
+    unsigned long poly_count = seeded ? 1 : cIndex;
+
+    for (unsigned long i = 0; i < poly_count && status == serialize_ok; i++) {
+        fmpz_poly_struct *poly = ptr[i].poly;
+        fmpz_poly_fit_length(poly, n);
+        _fmpz_poly_set_length(poly, n);
+
+        for (signed long d = 0; d < n && status == serialize_ok; d++) {
+            stream_read_limbs(&stream, limbs, qBits);
+            fmpz_set_ui_array(poly->coeffs + d, limbs, (signed long) limb_count);
+
+            if (stream.error) {
+                status = serialize_buffer_too_small;
+            }
+            else if (fmpz_cmp(poly->coeffs + d, q) >= 0) {
+                status = serialize_invalid_format;
+            }
+        }
+
+        _fmpz_poly_normalise(poly);
+    }
+
+    //c1 of seeded ciphertexts stays zero until it is expanded from the seed
+    if (seeded && status == serialize_ok) {
+        stream_align(&stream);
+        for (int i = 0; i < SEED_SIZE; i++) {
+            seed[i] = (unsigned char) stream_read(&stream, 8);
+        }
+    }
+
+    if (status == serialize_ok && stream.error) {
+        status = serialize_buffer_too_small;
+    }
+
+    if (status != serialize_ok) {
+        for (unsigned long i = 0; i < cIndex; i++) {
+            plwe_poly_clear(&ptr[i]);
+        }
+        free(ptr);
+        return status;
+    }
+
+    //Replace the existing polynomials, the storage of the message keeps its max_len
+    for (unsigned long i = 0; i < message->cIndex; i++) {
+        plwe_poly_clear(&message->c[i]);
+    }
+
+    for (unsigned long i = 0; i < cIndex; i++) {
+        message->c[i] = ptr[i];
+    }
+    free(ptr);
+
+    message->cIndex = cIndex;
+    message->seeded = seeded;
+
+    if (seeded) {
+        memcpy(message->seed, seed, SEED_SIZE);
+    }
+
+    //Expand once here if requested, read-only operations would otherwise expand a temporary copy on every read
+    if (expand) {
+        message_expand(message);
+    }
+
+    return serialize_ok;
+}
+
+int message_deserialize(struct message *message, const struct settings *settings, const void *buffer, size_t size,
+                        int expand) {
+    struct iovec iov = {.iov_base = (void *) buffer, .iov_len = size};
+    return message_deserialize_iov(message, settings, &iov, 1, expand);
+}
+
+int message_save(const struct message *message, const char *path) {
+    size_t size = message_serialized_size(message);
+    void *buffer = malloc(size);
+
+    int result = message_serialize(message, buffer, size);
+
+    if (result == serialize_ok) {
+        FILE *fp;
+        fp = fopen(path, "wb");
+
+        if (fp == NULL || fwrite(buffer, 1, size, fp) != size) {
+            result = serialize_io_error;
+        }
+
+        if (fp != NULL) {
+            fclose(fp);
+        }
+    }
+
+    free(buffer);
+
+    return result;
+}
+
+int message_load(struct message *message, const struct settings *settings, const char *path, int expand) {
+    FILE *fp;
+    fp = fopen(path, "rb");
+
+    if (fp == NULL) {
+        return serialize_io_error;
+    }
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    if (size < 0) {
+        fclose(fp);
+        return serialize_io_error;
+    }
+
+    void *buffer = malloc(size);
+    int result = serialize_io_error;
+
+    if (fread(buffer, 1, size, fp) == (size_t) size) {
+        result = message_deserialize(message, settings, buffer, size, expand);
+    }
+
+    fclose(fp);
+    free(buffer);
+
+    return result;
+}
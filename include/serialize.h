@@ -0,0 +1,91 @@
+#ifndef CUSTOM_SERIALIZE_H
+#define CUSTOM_SERIALIZE_H
+
+#include <stddef.h>
+#include <sys/uio.h>
+
+#define MESSAGE_FORMAT_MAGIC "PLWE"
+#define MESSAGE_FORMAT_VERSION 1
+#define MESSAGE_HEADER_SIZE 32
+#define MESSAGE_FLAG_SEEDED 0x1     // c1 is stored as seed
+
+//Forward declarations
+struct message;     /// defined in message.h
+struct settings;    /// defined in util.h
+
+// Binary ciphertext format (all integers little endian)
+//  0  magic "PLWE"
+//  4  u16 version
+//  6  u16 flags
+//  8  u32 cIndex
+// 12  u32 max_len
+// 16  u32 n
+// 20  u32 qBits
+// 24  u64 ring parameters id (hash of n and q)
+// 32  cIndex * n coefficients, packed LSB first with qBits bits each
+//     or, if flags contains MESSAGE_FLAG_SEEDED, n coefficients of c0 followed by the SEED_SIZE byte seed of c1
+
+enum serialize_status {
+    serialize_ok = 0,
+    serialize_buffer_too_small = 1,
+    serialize_invalid_format = 2,
+    serialize_unknown_ring = 3,
+    serialize_message_too_small = 4,
+    serialize_io_error = 5,
+};
+
+/// Compute the size of a serialized ciphertext
+/// @param[in] message Ciphertext
+/// @return Size in bytes
+size_t message_serialized_size(const struct message *message);
+
+/// Serialize a ciphertext directly from its coefficients into caller provided buffers (scatter)
+/// @param[in] message Ciphertext
+/// @param[in] iov Buffers, filled in order
+/// @param[in] iovcnt Amount of buffers
+/// @return serialize_ok or an error of enum serialize_status
+int message_serialize_iov(const struct message *message, const struct iovec *iov, int iovcnt);
+
+/// Serialize a ciphertext into a buffer
+/// @param[in] message Ciphertext
+/// @param[out] buffer Buffer of at least message_serialized_size bytes
+/// @param[in] size Size of the buffer
+/// @return serialize_ok or an error of enum serialize_status
+int message_serialize(const struct message *message, void *buffer, size_t size);
+/// Deserialize a ciphertext from several buffers (gather)
+/// Deserialize a ciphertext directly into the coefficients of a message (gather)
+/// The message is only replaced if the whole input is valid, it is left unchanged on errors
+/// @param[in,out] message Ciphertext initialized with message_init
+/// @param[in] settings Settings, q or one modulus of the modulus chain must match the serialized ciphertext
+/// @param[in] iov Buffers, read in order
+/// @param[in] iovcnt Amount of buffers
+/// @param[in] expand Expand c1 of a seeded ciphertext once, otherwise it keeps its seed (see message_expand)
+/// @return serialize_ok or an error of enum serialize_status
+int message_deserialize_iov(struct message *message, const struct settings *settings, const struct iovec *iov, int iovcnt,
+                            int expand);
+
+/// Deserialize a ciphertext from a buffer
+/// @param[in,out] message Ciphertext initialized with message_init
+/// @param[in] settings Settings, q or one modulus of the modulus chain must match the serialized ciphertext
+/// @param[in] buffer Buffer
+/// @param[in] size Size of the buffer
+/// @param[in] expand Expand c1 of a seeded ciphertext once, otherwise it keeps its seed (see message_expand)
+/// @return serialize_ok or an error of enum serialize_status
+int message_deserialize(struct message *message, const struct settings *settings, const void *buffer, size_t size,
+                        int expand);
+
+/// Save a ciphertext to a file
+/// @param[in] message Ciphertext
+/// @param[in] path Filepath
+/// @return serialize_ok or an error of enum serialize_status
+int message_save(const struct message *message, const char *path);
+
+/// Load a ciphertext from a file
+/// @param[in,out] message Ciphertext initialized with message_init
+/// @param[in] settings Settings, q or one modulus of the modulus chain must match the saved ciphertext
+/// @param[in] path Filepath
+/// @param[in] expand Expand c1 of a seeded ciphertext once, otherwise it keeps its seed (see message_expand)
+/// @return serialize_ok or an error of enum serialize_status
+int message_load(struct message *message, const struct settings *settings, const char *path, int expand);
+
+#endif //CUSTOM_SERIALIZE_H
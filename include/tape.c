@@ -0,0 +1,562 @@
+#include "tape.h"
+
+#include "asym.h"
+#include "binary_tree.h"
+#include "message.h"
+#include "plain.h"
+#include "threading.h"
+#include "util.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TAPE_INITIAL_CAPACITY 64    // Initial size of the growing arrays of the compiler, doubled when full
+#define TAPE_UNASSIGNED ((unsigned long) -1)
+
+enum tape_value_kind {
+    value_input = 1,
+    value_constant = 2,
+    value_register = 3,     // Virtual register until the registers are allocated
+    value_expression = 4,   // Constant expression whose value overflows a constant, applied operand by operand
+};
+
+/// Result of a compiled node
+struct tape_value {
+    enum tape_value_kind kind;
+    unsigned long index;    // Input or virtual register
+    signed long constant;   // Value of a constant, used for folding
+    unsigned long len;      // Expected amount of ciphertext elements
+};
+
+struct tape_compiler {
+    struct tape *tape;
+    const struct settings *settings;
+    int relinearize;
+
+    //Node -> index of its value (open addressing), every distinct node is compiled once
+    const struct node **keys;
+    unsigned long *values_of_keys;
+    unsigned long map_capacity;
+
+    struct tape_value *values;
+    unsigned long n_values;
+    unsigned long values_capacity;
+
+    signed long *constants;
+    unsigned long constants_capacity;
+
+    unsigned long n_vregs;
+};
+
+static inline __attribute__((always_inline)) unsigned long max_ulong(unsigned long x, unsigned long y) {
+    return (x > y) ? x : y;
+}
+
+static unsigned long ptr_hash(const void *ptr, unsigned long capacity) {
+    uintptr_t x = (uintptr_t) ptr;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdUL;
+    x ^= x >> 33;
+
+    return (unsigned long) x & (capacity - 1);
+}
+
+static void map_insert(struct tape_compiler *compiler, const struct node *node, unsigned long index) {
+    unsigned long i = ptr_hash(node, compiler->map_capacity);
+
+    while (compiler->keys[i] != NULL) {
+        i = (i + 1) & (compiler->map_capacity - 1);
+    }
+
+    compiler->keys[i] = node;
+    compiler->values_of_keys[i] = index;
+}
+
+static unsigned long map_find(const struct tape_compiler *compiler, const struct node *node) {
+    unsigned long i = ptr_hash(node, compiler->map_capacity);
+
+    while (compiler->keys[i] != NULL) {
+        if (compiler->keys[i] == node) {
+            return compiler->values_of_keys[i];
+        }
+        i = (i + 1) & (compiler->map_capacity - 1);
+    }
+
+    return TAPE_UNASSIGNED;
+}
+
+/// Store the value of a node
+/// @return Index of the value
+static unsigned long add_value(struct tape_compiler *compiler, const struct node *node, struct tape_value value) {
+    if (compiler->n_values == compiler->values_capacity) {
+        compiler->values_capacity *= 2;
+        compiler->values = realloc(compiler->values, compiler->values_capacity * sizeof(struct tape_value));
+    }
+    compiler->values[compiler->n_values] = value;
+
+    if (2 * (compiler->n_values + 1) > compiler->map_capacity) {
+        //Grow, rehash all nodes
+        const struct node **keys = compiler->keys;
+        unsigned long *values_of_keys = compiler->values_of_keys;
+        unsigned long capacity = compiler->map_capacity;
+
+        compiler->map_capacity *= 2;
+        compiler->keys = calloc(compiler->map_capacity, sizeof(struct node *));
+        compiler->values_of_keys = malloc(compiler->map_capacity * sizeof(unsigned long));
+
+        for (unsigned long i = 0; i < capacity; i++) {
+            if (keys[i] != NULL) {
+                map_insert(compiler, keys[i], values_of_keys[i]);
+            }
+        }
+
+        free(keys);
+        free(values_of_keys);
+    }
+
+    map_insert(compiler, node, compiler->n_values);
+
+    return compiler->n_values++;
+}
+
+static inline int is_plaintext(const struct tape_value *value) {
+    return value->kind == value_constant || value->kind == value_expression;
+}
+
+static unsigned long add_constant(struct tape_compiler *compiler, signed long constant) {
+    struct tape *tape = compiler->tape;
+
+    for (unsigned long i = 0; i < tape->n_constants; i++) {
+        if (compiler->constants[i] == constant) {
+            return i;
+        }
+    }
+
+    if (tape->n_constants == compiler->constants_capacity) {
+        compiler->constants_capacity *= 2;
+        compiler->constants = realloc(compiler->constants, compiler->constants_capacity * sizeof(signed long));
+    }
+    compiler->constants[tape->n_constants] = constant;
+
+    return tape->n_constants++;
+}
+
+static void emit(struct tape *tape, enum tape_opcode op, unsigned long dst, const struct tape_value *src1,
+                 const struct tape_value *src2) {
+    if (tape->length == tape->capacity) {
+        tape->capacity *= 2;
+        tape->code = realloc(tape->code, tape->capacity * sizeof(struct tape_instruction));
+    }
+
+    struct tape_instruction *instruction = &tape->code[tape->length++];
+    instruction->op = op;
+    instruction->dst = dst;
+    instruction->kind1 = (src1->kind == value_input) ? tape_input : tape_register;
+    instruction->src1 = src1->index;
+    instruction->kind2 = (src2 != NULL && src2->kind == value_input) ? tape_input : tape_register;
+    instruction->src2 = (src2 != NULL) ? src2->index : 0;
+}
+
+/// Apply a compiled constant node to a ciphertext with plain operations
+/// Expressions that can't be folded are applied operand by operand, x * (a * b) = (x * a) * b
+/// @param[in,out] compiler Compiler
+/// @param[in] type Operation
+/// @param[in,out] ciphertext Ciphertext operand, replaced by the result
+/// @param[in] plain_node Constant or constant expression node
+/// @return 0 on success, 1 if an expression mixes additions and multiplications
+static int emit_plain(struct tape_compiler *compiler, enum node_type type, struct tape_value *ciphertext,
+                      const struct node *plain_node) {
+    struct tape_value plaintext = compiler->values[map_find(compiler, plain_node)];
+
+    if (plaintext.kind == value_expression) {
+        if (plain_node->type != type) {
+            printf("Error, constant expression exceeds the range of a constant!\n");
+            return 1;
+        }
+
+        return emit_plain(compiler, type, ciphertext, plain_node->left_node) ||
+               emit_plain(compiler, type, ciphertext, plain_node->right_node);
+    }
+
+    plaintext.index = add_constant(compiler, plaintext.constant);
+
+    struct tape_value result;
+    result.kind = value_register;
+    result.index = compiler->n_vregs++;
+    result.constant = 0;
+    result.len = ciphertext->len;
+
+    emit(compiler->tape, (type == plus) ? tape_add_plain : tape_mul_plain, result.index, ciphertext, &plaintext);
+    *ciphertext = result;
+
+    return 0;
+}
+
+/// Compile a node after its operands (post-order)
+/// @param[in,out] compiler Compiler
+/// @param[in] node Node
+/// @return Index of the value of node, TAPE_UNASSIGNED on error
+static unsigned long compile_node(struct tape_compiler *compiler, const struct node *node) {
+    unsigned long index = map_find(compiler, node);
+
+    if (index != TAPE_UNASSIGNED) {
+        //Shared node
+        return index;
+    }
+
+    struct tape_value value;
+
+    if (node->left_node == NULL && node->right_node == NULL) {
+        if (node->type == constant) {
+            value.kind = value_constant;
+            value.constant = node->M;
+            value.index = 0;        // Added to the constants once a plain operation uses it
+            value.len = 0;
+        }
+        else {
+            value.kind = value_input;
+            value.index = compiler->tape->n_inputs++;
+            value.len = 2;
+        }
+
+        return add_value(compiler, node, value);
+    }
+
+    if (node->left_node == NULL || node->right_node == NULL) {
+        printf("Error, operation node with a single operand!\n");
+        return TAPE_UNASSIGNED;
+    }
+
+    unsigned long left = compile_node(compiler, node->left_node);
+    unsigned long right = (left == TAPE_UNASSIGNED) ? TAPE_UNASSIGNED : compile_node(compiler, node->right_node);
+    if (right == TAPE_UNASSIGNED) {
+        return TAPE_UNASSIGNED;
+    }
+
+    //Copies, values may be reallocated by add_value
+    struct tape_value operand1 = compiler->values[left];
+    struct tape_value operand2 = compiler->values[right];
+
+    if (is_plaintext(&operand1) && is_plaintext(&operand2)) {
+        //Fold, a result that overflows is kept as expression and applied at runtime
+        int overflow = operand1.kind == value_expression || operand2.kind == value_expression;
+
+        if (!overflow && node->type == plus) {
+            overflow = __builtin_add_overflow(operand1.constant, operand2.constant, &value.constant);
+        }
+        else if (!overflow) {
+            overflow = __builtin_mul_overflow(operand1.constant, operand2.constant, &value.constant);
+        }
+
+        value.kind = overflow ? value_expression : value_constant;
+        value.constant = overflow ? 0 : value.constant;
+        value.index = 0;
+        value.len = 0;
+
+        return add_value(compiler, node, value);
+    }
+
+    if (is_plaintext(&operand1) || is_plaintext(&operand2)) {
+        //Plain operation, the ciphertext is the first operand
+        value = is_plaintext(&operand1) ? operand2 : operand1;
+
+        if (emit_plain(compiler, node->type, &value, is_plaintext(&operand1) ? node->left_node : node->right_node) != 0) {
+            return TAPE_UNASSIGNED;
+        }
+
+        return add_value(compiler, node, value);
+    }
+
+    value.kind = value_register;
+    value.index = compiler->n_vregs++;
+
+    if (node->type == plus) {
+        emit(compiler->tape, tape_add, value.index, &operand1, &operand2);
+        value.len = max_ulong(operand1.len, operand2.len);
+    }
+    else {
+        emit(compiler->tape, tape_mul, value.index, &operand1, &operand2);
+        value.len = operand1.len + operand2.len - 1;
+
+        if (value.len > compiler->settings->D) {
+            printf("Error, ciphertext exceeds the maximum length of %ld elements!\n", compiler->settings->D);
+            return TAPE_UNASSIGNED;
+        }
+
+        //Shrink products of two 2 element ciphertexts immediately, later operations stay cheap
+        if (compiler->relinearize && value.len == 3) {
+            emit(compiler->tape, tape_relin, value.index, &value, NULL);
+            value.len = 2;
+        }
+    }
+
+    return add_value(compiler, node, value);
+}
+
+/// Map the virtual registers to as few registers as possible, a register is reused once its value is dead
+/// @param[in,out] tape Tape, the instructions use virtual registers
+/// @param[in] n_vregs Amount of virtual registers
+/// @param[in] root Virtual register of the result, mapped to register 0
+static void allocate_registers(struct tape *tape, unsigned long n_vregs, unsigned long root) {
+    unsigned long *last_use = malloc(n_vregs * sizeof(unsigned long));
+    unsigned long *registers = malloc(n_vregs * sizeof(unsigned long));
+    unsigned long *free_registers = malloc(n_vregs * sizeof(unsigned long));
+    unsigned long n_free = 0;
+
+    //Liveness, a value is dead after the last instruction reading it
+    for (unsigned long v = 0; v < n_vregs; v++) {
+        last_use[v] = 0;
+        registers[v] = TAPE_UNASSIGNED;
+    }
+
+    for (unsigned long i = 0; i < tape->length; i++) {
+        struct tape_instruction *instruction = &tape->code[i];
+
+        if (instruction->kind1 == tape_register) {
+            last_use[instruction->src1] = i;
+        }
+        if ((instruction->op == tape_add || instruction->op == tape_mul) && instruction->kind2 == tape_register) {
+            last_use[instruction->src2] = i;
+        }
+    }
+
+    registers[root] = 0;
+    tape->n_registers = 1;
+
+    for (unsigned long i = 0; i < tape->length; i++) {
+        struct tape_instruction *instruction = &tape->code[i];
+        int binary = (instruction->op == tape_add || instruction->op == tape_mul);
+
+        //Release dead operands first, the result may reuse their register (all operations allow aliasing)
+        if (instruction->kind1 == tape_register && last_use[instruction->src1] == i &&
+            instruction->src1 != instruction->dst && instruction->src1 != root) {
+            free_registers[n_free++] = registers[instruction->src1];
+        }
+        if (binary && instruction->kind2 == tape_register && last_use[instruction->src2] == i &&
+            instruction->src2 != instruction->src1 && instruction->src2 != root) {
+            free_registers[n_free++] = registers[instruction->src2];
+        }
+
+        if (registers[instruction->dst] == TAPE_UNASSIGNED) {
+            registers[instruction->dst] = (n_free > 0) ? free_registers[--n_free] : tape->n_registers++;
+        }
+
+        //Rewrite
+        if (instruction->kind1 == tape_register) {
+            instruction->src1 = registers[instruction->src1];
+        }
+        if (binary && instruction->kind2 == tape_register) {
+            instruction->src2 = registers[instruction->src2];
+        }
+        instruction->dst = registers[instruction->dst];
+    }
+
+    free(last_use);
+    free(registers);
+    free(free_registers);
+}
+
+int tape_compile(struct tape *tape, const struct node *root, const struct settings *settings, int relinearize) {
+    tape->capacity = TAPE_INITIAL_CAPACITY;
+    tape->code = malloc(tape->capacity * sizeof(struct tape_instruction));
+    tape->length = 0;
+    tape->n_inputs = 0;
+    tape->n_registers = 0;
+    tape->constants = NULL;
+    tape->n_constants = 0;
+    tape->result_input = -1;
+
+    struct tape_compiler compiler;
+    compiler.tape = tape;
+    compiler.settings = settings;
+    compiler.relinearize = relinearize;
+    compiler.map_capacity = TAPE_INITIAL_CAPACITY;
+    compiler.keys = calloc(compiler.map_capacity, sizeof(struct node *));
+    compiler.values_of_keys = malloc(compiler.map_capacity * sizeof(unsigned long));
+    compiler.values_capacity = TAPE_INITIAL_CAPACITY;
+    compiler.values = malloc(compiler.values_capacity * sizeof(struct tape_value));
+    compiler.n_values = 0;
+    compiler.constants_capacity = TAPE_INITIAL_CAPACITY;
+    compiler.constants = malloc(compiler.constants_capacity * sizeof(signed long));
+    compiler.n_vregs = 0;
+
+    int error = 0;
+    unsigned long index = compile_node(&compiler, root);
+
+    if (index == TAPE_UNASSIGNED) {
+        error = 1;
+    }
+    else if (is_plaintext(&compiler.values[index])) {
+        printf("Error, the result of the tree is a constant!\n");
+        error = 1;
+    }
+    else if (compiler.values[index].kind == value_input) {
+        //Nothing to compute
+        tape->result_input = (long) compiler.values[index].index;
+    }
+    else {
+        allocate_registers(tape, compiler.n_vregs, compiler.values[index].index);
+    }
+
+    if (error == 0) {
+        //Encode once, the tape is reused for every run
+        tape->constants = malloc(tape->n_constants * sizeof(struct plain));
+
+        for (unsigned long i = 0; i < tape->n_constants; i++) {
+            plain_init_si(&tape->constants[i], compiler.constants[i], settings, plain_auto);
+        }
+    }
+    else {
+        tape->n_constants = 0;
+        tape_clear(tape);
+    }
+
+    free(compiler.keys);
+    free(compiler.values_of_keys);
+    free(compiler.values);
+    free(compiler.constants);
+
+    return error;
+}
+
+void tape_clear(struct tape *tape) {
+    for (unsigned long i = 0; i < tape->n_constants; i++) {
+        plain_clear(&tape->constants[i]);
+    }
+
+    free(tape->constants);
+    free(tape->code);
+    tape->constants = NULL;
+    tape->code = NULL;
+    tape->n_constants = 0;
+    tape->length = 0;
+    tape->capacity = 0;
+}
+
+static void print_operand(enum tape_operand kind, unsigned long index) {
+    printf("%s%ld", (kind == tape_input) ? "i" : "r", index);
+}
+
+void tape_print(const struct tape *tape) {
+    printf("Tape: %ld instructions, %ld inputs, %ld registers, %ld constants\n", tape->length, tape->n_inputs,
+           tape->n_registers, tape->n_constants);
+
+    if (tape->result_input >= 0) {
+        printf("r0 = i%ld\n", tape->result_input);
+    }
+
+    for (unsigned long i = 0; i < tape->length; i++) {
+        const struct tape_instruction *instruction = &tape->code[i];
+
+        printf("r%ld = ", instruction->dst);
+
+        switch (instruction->op) {
+            case tape_relin:
+                printf("relin ");
+                print_operand(instruction->kind1, instruction->src1);
+                break;
+            case tape_add_plain:
+            case tape_mul_plain:
+                print_operand(instruction->kind1, instruction->src1);
+                printf(" %c c%ld", (instruction->op == tape_add_plain) ? '+' : '*', instruction->src2);
+                break;
+            default:
+                print_operand(instruction->kind1, instruction->src1);
+                printf(" %c ", (instruction->op == tape_add) ? '+' : '*');
+                print_operand(instruction->kind2, instruction->src2);
+        }
+
+        printf("\n");
+    }
+}
+
+int tape_run(struct message *result, const struct tape *tape, struct message *const inputs[],
+             const struct settings *settings, struct thread_pool *pool, struct key_eval *key_eval) {
+    //Seeded inputs are expanded in place, the ciphertexts they represent do not change
+    for (unsigned long i = 0; i < tape->n_inputs; i++) {
+        message_expand(inputs[i]);
+    }
+
+    if (tape->result_input >= 0) {
+        message_set(result, inputs[tape->result_input]);
+        return 0;
+    }
+
+    //Register 0 is the result
+    struct message *storage = malloc(tape->n_registers * sizeof(struct message));
+    struct message **registers = malloc(tape->n_registers * sizeof(struct message *));
+
+    registers[0] = result;
+    for (unsigned long i = 1; i < tape->n_registers; i++) {
+        message_init(&storage[i], settings);
+        registers[i] = &storage[i];
+    }
+
+    int error = 0;
+
+    for (unsigned long i = 0; i < tape->length && error == 0; i++) {
+        const struct tape_instruction *instruction = &tape->code[i];
+        struct message *dst = registers[instruction->dst];
+        struct message *operand1 = (instruction->kind1 == tape_input) ? inputs[instruction->src1] : registers[instruction->src1];
+        struct message *operand2 = NULL;
+
+        if (instruction->op == tape_add || instruction->op == tape_mul) {
+            operand2 = (instruction->kind2 == tape_input) ? inputs[instruction->src2] : registers[instruction->src2];
+        }
+
+        switch (instruction->op) {
+            case tape_add:
+                if (max_ulong(operand1->cIndex, operand2->cIndex) > dst->max_len) {
+                    error = 1;
+                    break;
+                }
+                eval_add(dst, operand1, operand2);
+                break;
+            case tape_mul:
+                if (operand1->cIndex + operand2->cIndex - 1 > dst->max_len) {
+                    error = 1;
+                    break;
+                }
+                eval_mul_parallel(pool, dst, operand1, operand2);
+                break;
+            case tape_relin:
+                if (key_eval == NULL) {
+                    printf("Error, the tape relinearizes but no evaluation key was given!\n");
+                    error = 1;
+                    break;
+                }
+                if (dst->cIndex == 3) {
+                    message_relinearize(dst, key_eval);
+                }
+                break;
+            case tape_add_plain:
+            case tape_mul_plain:
+                if (operand1->cIndex > dst->max_len) {
+                    error = 1;
+                    break;
+                }
+
+                message_set(dst, operand1);
+                if (instruction->op == tape_add_plain) {
+                    eval_add_plain_enc(dst, dst, &tape->constants[instruction->src2]);
+                }
+                else {
+                    eval_mul_plain_enc(dst, dst, &tape->constants[instruction->src2]);
+                }
+                break;
+        }
+
+        if (error != 0 && instruction->op != tape_relin) {
+            printf("Error, ciphertext exceeds the maximum length of %ld elements!\n", dst->max_len);
+        }
+    }
+
+    for (unsigned long i = 1; i < tape->n_registers; i++) {
+        message_clear(&storage[i]);
+    }
+    free(storage);
+    free(registers);
+
+    return error;
+}
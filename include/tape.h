@@ -0,0 +1,76 @@
+#ifndef CUSTOM_TAPE_H
+#define CUSTOM_TAPE_H
+
+//Forward declarations
+struct key_eval;    /// defined in key.h
+struct message;     /// defined in message.h
+struct node;        /// defined in binary_tree.h
+struct plain;       /// defined in plain.h
+struct settings;    /// defined in util.h
+struct thread_pool; /// defined in threading.h
+
+enum tape_opcode {
+    tape_add = 1,           // dst = src1 + src2
+    tape_mul = 2,           // dst = src1 * src2
+    tape_relin = 3,         // dst = relinearize(dst), src1 is dst
+    tape_add_plain = 4,     // dst = src1 + constants[src2]
+    tape_mul_plain = 5,     // dst = src1 * constants[src2]
+};
+
+enum tape_operand {
+    tape_register = 1,      // Ciphertext register, register 0 is the result
+    tape_input = 2,         // Input ciphertext passed to tape_run
+};
+
+struct tape_instruction {
+    enum tape_opcode op;
+    unsigned long dst;              // Register
+    enum tape_operand kind1;
+    unsigned long src1;
+    enum tape_operand kind2;        // Unused by plain operations and tape_relin
+    unsigned long src2;             // Constant index of plain operations
+};
+
+/// Arithmetic tree (or DAG) compiled to a linear instruction sequence over ciphertext registers
+/// Registers are reused as soon as their value is dead, n_registers bounds the ciphertexts alive during tape_run
+struct tape {
+    struct tape_instruction *code;
+    unsigned long length;
+    unsigned long capacity;
+    unsigned long n_inputs;         // Distinct value nodes, numbered in post-order (left operand first)
+    unsigned long n_registers;      // Including the result register 0
+    struct plain *constants;        // Encoded constant nodes
+    unsigned long n_constants;
+    long result_input;              // Input returned as result if the root is a value node, -1 otherwise
+};
+
+/// Compile a tree or DAG, every distinct node is evaluated once; constants are folded and encoded
+/// Constant expressions that overflow a signed long are not folded, their operands are applied one by one instead
+/// @param[out] tape Tape, clear with tape_clear
+/// @param[in] root Root node, value nodes are inputs (their ciphertexts are not used) and constant nodes plaintexts
+/// @param[in] settings Settings used to encode the constants, maximum ciphertext length D
+/// @param[in] relinearize If != 0, every product of two 2 element ciphertexts is relinearized (tape_run requires key_eval)
+/// @return 0 on success, 1 if the root is a constant, a node has a single operand, a ciphertext would exceed D elements
+///         or an overflowing constant expression mixes additions and multiplications
+int tape_compile(struct tape *tape, const struct node *root, const struct settings *settings, int relinearize);
+
+/// Free a tape
+/// @param[in,out] tape Tape
+void tape_clear(struct tape *tape);
+
+/// Print the instructions of a tape
+/// @param[in] tape Tape
+void tape_print(const struct tape *tape);
+
+/// Evaluate a tape homomorphically, the registers are allocated for the run and cleared afterwards
+/// @param[out] result Ciphertext initialized with message_init
+/// @param[in] tape Tape
+/// @param[in] inputs Ciphertexts of the value nodes in input order (tape->n_inputs), the inputs are not modified
+/// @param[in] settings Settings used to initialize the registers
+/// @param[in,out] pool Thread pool used for the products, NULL to evaluate in the calling thread
+/// @param[in] key_eval Evaluation key, required if the tape relinearizes
+/// @return 0 on success, 1 if a ciphertext exceeds its maximum length or the evaluation key is missing
+int tape_run(struct message *result, const struct tape *tape, struct message *const inputs[],
+             const struct settings *settings, struct thread_pool *pool, struct key_eval *key_eval);
+
+#endif //CUSTOM_TAPE_H
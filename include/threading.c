@@ -1,9 +1,29 @@
 #include "threading.h"
 
 #include "asym.h"
+#include "instrument.h"
+#include "message.h"
+#include "plwe_poly.h"
 
+#include <flint/fmpz_poly.h>
 #include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TASK_DEQUE_CAPACITY 64      // Initial capacity of a worker deque, doubled when full
+#define HELP_WAIT_NS 1000000        // Sleep of a waiting thread that found no task to help with
+
+struct task {
+    void (*func)(void *arg);
+    void *arg;
+    struct task_group *group;
+};
+
+//Worker of the current thread, NULL for threads outside of every pool
+static __thread struct thread_pool_worker *current_worker = NULL;
 
 void * eval_add_threaded(struct eval_thread_args *struct_arg) {
     eval_add(struct_arg->result, struct_arg->message1, struct_arg->message2);
@@ -28,3 +48,496 @@ struct eval_thread_args * assign_thread_args(struct message *result, struct mess
 inline __attribute__((always_inline)) void clear_thread_args(struct eval_thread_args *etargs) {
     free(etargs);
 }
+
+void task_group_init(struct task_group *group) {
+    group->pending = 0;
+    pthread_mutex_init(&group->lock, NULL);
+    pthread_cond_init(&group->cond, NULL);
+}
+
+void task_group_clear(struct task_group *group) {
+    pthread_mutex_destroy(&group->lock);
+    pthread_cond_destroy(&group->cond);
+}
+
+static void task_group_add(struct task_group *group) {
+    pthread_mutex_lock(&group->lock);
+    group->pending++;
+    pthread_mutex_unlock(&group->lock);
+}
+
+static void task_group_done(struct task_group *group) {
+    //Decrement under the lock, a waiter may clear the group as soon as it observes 0
+    pthread_mutex_lock(&group->lock);
+    if (--group->pending == 0) {
+        pthread_cond_broadcast(&group->cond);
+    }
+    pthread_mutex_unlock(&group->lock);
+}
+
+static void task_deque_init(struct task_deque *deque) {
+    pthread_mutex_init(&deque->lock, NULL);
+    deque->tasks = malloc(TASK_DEQUE_CAPACITY * sizeof(struct task *));
+    deque->capacity = TASK_DEQUE_CAPACITY;
+    deque->top = 0;
+    deque->bottom = 0;
+}
+
+static void task_deque_clear(struct task_deque *deque) {
+    pthread_mutex_destroy(&deque->lock);
+    free(deque->tasks);
+}
+
+static void task_deque_push(struct task_deque *deque, struct task *task) {
+    pthread_mutex_lock(&deque->lock);
+
+    if (deque->bottom - deque->top == deque->capacity) {
+        //Full, unroll the circular buffer into one of twice the size
+        struct task **tasks = malloc(2 * deque->capacity * sizeof(struct task *));
+        for (unsigned long i = deque->top; i < deque->bottom; i++) {
+            tasks[i - deque->top] = deque->tasks[i % deque->capacity];
+        }
+
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->bottom -= deque->top;
+        deque->top = 0;
+        deque->capacity *= 2;
+    }
+
+    deque->tasks[deque->bottom % deque->capacity] = task;
+    deque->bottom++;
+
+    pthread_mutex_unlock(&deque->lock);
+}
+
+static struct task * task_deque_pop(struct task_deque *deque) {
+    struct task *task = NULL;
+
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        deque->bottom--;
+        task = deque->tasks[deque->bottom % deque->capacity];      //Newest task, its data is likely cached
+    }
+    pthread_mutex_unlock(&deque->lock);
+
+    return task;
+}
+
+static struct task * task_deque_steal(struct task_deque *deque) {
+    struct task *task = NULL;
+
+    pthread_mutex_lock(&deque->lock);
+    if (deque->bottom != deque->top) {
+        task = deque->tasks[deque->top % deque->capacity];         //Oldest task, usually the largest piece of work
+        deque->top++;
+    }
+    pthread_mutex_unlock(&deque->lock);
+
+    return task;
+}
+
+/// Fetch a task, first from the own deque (if the thread is a worker of pool), then from a random victim
+/// @param[in,out] pool Thread pool
+/// @return Task or NULL if all deques are empty
+static struct task * find_task(struct thread_pool *pool) {
+    struct thread_pool_worker *self = (current_worker != NULL && current_worker->pool == pool) ? current_worker : NULL;
+    struct task *task = NULL;
+    unsigned int start;
+
+    if (atomic_load(&pool->queued) == 0) {
+        return NULL;
+    }
+
+    if (self != NULL) {
+        task = task_deque_pop(&self->deque);
+
+        //xorshift, only used to spread the thieves over the victims
+        self->seed ^= self->seed << 13;
+        self->seed ^= self->seed >> 17;
+        self->seed ^= self->seed << 5;
+        start = self->seed;
+    }
+    else {
+        start = atomic_fetch_add(&pool->next, 1);
+    }
+
+    for (unsigned int i = 0; task == NULL && i < pool->n_threads; i++) {
+        struct thread_pool_worker *victim = &pool->workers[(start + i) % pool->n_threads];
+        if (victim != self) {
+            task = task_deque_steal(&victim->deque);
+        }
+    }
+
+    if (task != NULL) {
+        atomic_fetch_sub(&pool->queued, 1);
+    }
+
+    return task;
+}
+
+static void run_task(struct thread_pool *pool, struct task *task) {
+    task->func(task->arg);
+
+    if (task->group != NULL) {
+        task_group_done(task->group);
+    }
+    task_group_done(&pool->all);
+
+    free(task);
+}
+
+static void * worker_main(void *arg) {
+    struct thread_pool_worker *worker = arg;
+    struct thread_pool *pool = worker->pool;
+    current_worker = worker;
+
+    while (1) {
+        struct task *task = find_task(pool);
+        if (task != NULL) {
+            run_task(pool, task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (atomic_load(&pool->queued) == 0 && !pool->shutdown) {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+
+        //Leave only when all queued tasks were taken
+        if (pool->shutdown && atomic_load(&pool->queued) == 0) {
+            pthread_mutex_unlock(&pool->lock);
+            break;
+        }
+        pthread_mutex_unlock(&pool->lock);
+    }
+
+    current_worker = NULL;
+    return NULL;
+}
+
+void thread_pool_init(struct thread_pool *pool, unsigned int n_threads) {
+    if (n_threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        n_threads = (online > 0) ? (unsigned int) online : 1;
+    }
+
+    pool->n_threads = n_threads;
+    pool->workers = malloc(n_threads * sizeof(struct thread_pool_worker));
+    atomic_init(&pool->queued, 0);
+    atomic_init(&pool->next, 0);
+    pool->shutdown = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+    task_group_init(&pool->all);
+
+    //Initialize all deques before the first worker may try to steal
+    for (unsigned int i = 0; i < n_threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].seed = i + 1;
+        task_deque_init(&pool->workers[i].deque);
+    }
+
+    for (unsigned int i = 0; i < n_threads; i++) {
+        pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]);
+    }
+}
+
+void thread_pool_clear(struct thread_pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->shutdown = 1;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (unsigned int i = 0; i < pool->n_threads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    for (unsigned int i = 0; i < pool->n_threads; i++) {
+        task_deque_clear(&pool->workers[i].deque);
+    }
+
+    free(pool->workers);
+    task_group_clear(&pool->all);
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->cond);
+}
+
+void thread_pool_submit(struct thread_pool *pool, struct task_group *group, void (*func)(void *arg), void *arg) {
+    struct task *task = malloc(sizeof(struct task));
+    task->func = func;
+    task->arg = arg;
+    task->group = group;
+
+    //Count the task before it can run
+    if (group != NULL) {
+        task_group_add(group);
+    }
+    task_group_add(&pool->all);
+
+    if (current_worker != NULL && current_worker->pool == pool) {
+        task_deque_push(&current_worker->deque, task);
+    }
+    else {
+        task_deque_push(&pool->workers[atomic_fetch_add(&pool->next, 1) % pool->n_threads].deque, task);
+    }
+
+    //Signal under the lock, otherwise a worker between its check and its wait misses the task
+    pthread_mutex_lock(&pool->lock);
+    atomic_fetch_add(&pool->queued, 1);
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+int thread_pool_help(struct thread_pool *pool) {
+    struct task *task = find_task(pool);
+    if (task == NULL) {
+        return 0;
+    }
+
+    run_task(pool, task);
+    return 1;
+}
+
+void thread_pool_wait(struct thread_pool *pool, struct task_group *group) {
+    pthread_mutex_lock(&group->lock);
+
+    while (group->pending > 0) {
+        pthread_mutex_unlock(&group->lock);
+
+        //Help instead of blocking, the tasks of the group may be queued behind the current one
+        if (thread_pool_help(pool)) {
+            pthread_mutex_lock(&group->lock);
+            continue;
+        }
+
+        //Nothing to help with, the remaining tasks are running; wake up regularly as they may spawn new tasks
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += HELP_WAIT_NS;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+
+        pthread_mutex_lock(&group->lock);
+        if (group->pending > 0) {
+            pthread_cond_timedwait(&group->cond, &group->lock, &deadline);
+        }
+    }
+
+    pthread_mutex_unlock(&group->lock);
+}
+
+void thread_pool_barrier(struct thread_pool *pool) {
+    thread_pool_wait(pool, &pool->all);
+}
+
+// Typed tasks
+
+struct relinearize_task_args {
+    struct message *message;
+    struct key_eval *key_eval;
+};
+
+struct crypt_task_args {
+    struct message *message;
+    struct plwe_poly *m;
+    const struct key *key;
+};
+
+static void eval_add_task(void *arg) {
+    eval_add_threaded(arg);
+    clear_thread_args(arg);
+}
+
+static void eval_mul_task(void *arg) {
+    eval_mul_threaded(arg);
+    clear_thread_args(arg);
+}
+
+static void relinearize_task(void *arg) {
+    struct relinearize_task_args *args = arg;
+    message_relinearize(args->message, args->key_eval);
+    free(args);
+}
+
+static void encrypt_task(void *arg) {
+    struct crypt_task_args *args = arg;
+    encrypt(args->message, args->m, args->key);
+    free(args);
+}
+
+static void decrypt_task(void *arg) {
+    struct crypt_task_args *args = arg;
+    decrypt(args->m, args->message, args->key);
+    free(args);
+}
+
+void thread_pool_submit_eval_add(struct thread_pool *pool, struct task_group *group, struct message *result,
+                                 struct message *message1, struct message *message2) {
+    message_expand(message1);
+    message_expand(message2);
+    thread_pool_submit(pool, group, eval_add_task, assign_thread_args(result, message1, message2));
+}
+
+void thread_pool_submit_eval_mul(struct thread_pool *pool, struct task_group *group, struct message *result,
+                                 struct message *message1, struct message *message2) {
+    message_expand(message1);
+    message_expand(message2);
+    thread_pool_submit(pool, group, eval_mul_task, assign_thread_args(result, message1, message2));
+}
+
+void thread_pool_submit_relinearize(struct thread_pool *pool, struct task_group *group, struct message *message,
+                                    struct key_eval *key_eval) {
+    struct relinearize_task_args *args = malloc(sizeof(struct relinearize_task_args));
+    args->message = message;
+    args->key_eval = key_eval;
+
+    message_expand(message);
+    thread_pool_submit(pool, group, relinearize_task, args);
+}
+
+void thread_pool_submit_encrypt(struct thread_pool *pool, struct task_group *group, struct message *message,
+                                const struct plwe_poly *m, const struct key *key) {
+    struct crypt_task_args *args = malloc(sizeof(struct crypt_task_args));
+    args->message = message;
+    args->m = (struct plwe_poly *) m;   //Only read by encrypt
+    args->key = key;
+
+    thread_pool_submit(pool, group, encrypt_task, args);
+}
+
+void thread_pool_submit_decrypt(struct thread_pool *pool, struct task_group *group, struct plwe_poly *m,
+                                struct message *message, const struct key *key) {
+    struct crypt_task_args *args = malloc(sizeof(struct crypt_task_args));
+    args->message = message;
+    args->m = m;
+    args->key = key;
+
+    message_expand(message);
+    thread_pool_submit(pool, group, decrypt_task, args);
+}
+
+// Parallel multiplication
+
+struct eval_mul_parallel_args {
+    const struct message *message1;
+    const struct message *message2;
+    fmpz_poly_struct *products;     // cIndex1 * cIndex2 products, c_i * c'_j at i * cIndex2 + j
+    struct plwe_poly *output;
+    unsigned long index;            // Index of the product (first phase) or the output element (second phase)
+};
+
+static void eval_mul_product_task(void *arg) {
+    struct eval_mul_parallel_args *args = arg;
+    unsigned long i = args->index / args->message2->cIndex;
+    unsigned long j = args->index % args->message2->cIndex;
+
+    INSTRUMENT_COUNT(counter_ring_mul, 1);
+    fmpz_poly_mul(args->products + args->index, args->message1->c[i].poly, args->message2->c[j].poly);   //ci * c'j
+}
+
+static void eval_mul_accumulate_task(void *arg) {
+    struct eval_mul_parallel_args *args = arg;
+    unsigned long l1 = args->message1->cIndex;
+    unsigned long l2 = args->message2->cIndex;
+    unsigned long k = args->index;
+    struct plwe_poly *output = &args->output[k];
+
+    //Output k is the sum of all ci * c'j with i + j = k, only this task writes it
+    unsigned long i_min = (k + 1 > l2) ? k + 1 - l2 : 0;
+    unsigned long i_max = (k < l1 - 1) ? k : l1 - 1;
+
+    for (unsigned long i = i_min; i <= i_max; i++) {
+        fmpz_poly_add(output->poly, output->poly, args->products + i * l2 + (k - i));
+    }
+
+    plwe_poly_pmod(output);
+}
+
+void eval_mul_parallel(struct thread_pool *pool, struct message *result, const struct message *message1,
+                       const struct message *message2) {
+    if (pool == NULL) {
+        eval_mul(result, message1, message2);
+        return;
+    }
+
+    if (message1->cIndex < 2 || message2->cIndex < 2) {
+        printf("Error, polynomials do not match criteria!\n");
+        return;
+    }
+
+    unsigned long l1 = message1->cIndex;
+    unsigned long l2 = message2->cIndex;
+    unsigned long len = l1 + l2 - 1;
+
+    if (len > result->max_len){
+        printf("Error, result message too small to hold result!\n");
+        return;
+    }
+
+    INSTRUMENT_START(timer_eval_mul);
+
+    //Seeded inputs are expanded into temporary copies before the tasks share them, the inputs are only read
+    struct message temp1, temp2;
+    message1 = message_expanded(&temp1, message1);
+    message2 = message_expanded(&temp2, message2);
+
+    //Do computations in new allocated memory and replace existing memory to prevent overwrites of data
+    struct plwe_poly *ptr = malloc(result->max_len * sizeof(struct plwe_poly));
+    fmpz_poly_struct *products = malloc(l1 * l2 * sizeof(fmpz_poly_struct));
+    struct eval_mul_parallel_args *args = malloc(l1 * l2 * sizeof(struct eval_mul_parallel_args));
+
+    for (unsigned long k = 0; k < len; k++){
+        plwe_poly_init(&ptr[k], message1->c[0].mod, message1->c[0].n);     //Init plwe polys, take settings from message1
+    }
+
+    struct task_group group;
+    task_group_init(&group);
+
+    //First phase: all products are independent
+    for (unsigned long index = 0; index < l1 * l2; index++) {
+        fmpz_poly_init(products + index);
+
+        args[index].message1 = message1;
+        args[index].message2 = message2;
+        args[index].products = products;
+        args[index].output = ptr;
+        args[index].index = index;
+
+        thread_pool_submit(pool, &group, eval_mul_product_task, &args[index]);
+    }
+    thread_pool_wait(pool, &group);
+
+    //Second phase: one task per output element, len <= l1 * l2 so the arguments are reused
+    for (unsigned long k = 0; k < len; k++) {
+        args[k].index = k;
+        thread_pool_submit(pool, &group, eval_mul_accumulate_task, &args[k]);
+    }
+    thread_pool_wait(pool, &group);
+
+    task_group_clear(&group);
+
+    //Cleanup
+    for (unsigned long index = 0; index < l1 * l2; index++) {
+        fmpz_poly_clear(products + index);
+    }
+    free(products);
+    free(args);
+
+    //Replace the elements of result, it might be one of the inputs
+    for (unsigned long i = 0; i < result->cIndex; i++){
+        plwe_poly_clear(&result->c[i]);
+    }
+    free(result->c);
+
+    result->c = ptr;
+    result->cIndex = len;
+    result->seeded = 0;
+
+    message_expanded_clear(&temp1, message1);
+    message_expanded_clear(&temp2, message2);
+
+    INSTRUMENT_STOP(timer_eval_mul);
+}
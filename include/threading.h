@@ -1,8 +1,15 @@
 #ifndef CUSTOM_THREADING_H
 #define CUSTOM_THREADING_H
 
+#include <pthread.h>
+#include <stdatomic.h>
+
 //Forward declarations
-struct message;    /// defined in message.h
+struct key;         /// defined in key.h
+struct key_eval;    /// defined in key.h
+struct message;     /// defined in message.h
+struct plwe_poly;   /// defined in plwe_poly.h
+struct task;        /// defined in threading.c
 
 struct eval_thread_args {
     struct message *result;
@@ -10,6 +17,41 @@ struct eval_thread_args {
     struct message *message2;
 };
 
+/// Set of tasks which can be waited for
+struct task_group {
+    long pending;               // Submitted but not yet finished tasks
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        // Signaled when pending drops to 0
+};
+
+/// Double ended queue of a worker, the owner pushes and pops at the bottom, other threads steal from the top
+struct task_deque {
+    pthread_mutex_t lock;
+    struct task **tasks;        // Circular buffer
+    unsigned long capacity;
+    unsigned long top;
+    unsigned long bottom;
+};
+
+struct thread_pool_worker {
+    pthread_t thread;
+    struct thread_pool *pool;
+    struct task_deque deque;
+    unsigned int seed;          // Victim selection for stealing
+};
+
+/// Persistent worker threads with per worker deques and work stealing
+struct thread_pool {
+    unsigned int n_threads;
+    struct thread_pool_worker *workers;
+    atomic_long queued;         // Tasks in all deques
+    atomic_uint next;           // Round robin worker for tasks submitted from outside the pool
+    int shutdown;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;        // Signaled when tasks are queued or the pool shuts down
+    struct task_group all;      // Every task of the pool, used by thread_pool_barrier
+};
+
 /// Helper function to compute threaded addition using pthread; pass this to pthread_create
 /// @param[in] struct_arg Arguments for the eval_add function
 void * eval_add_threaded(struct eval_thread_args *struct_arg);
@@ -29,4 +71,100 @@ struct eval_thread_args * assign_thread_args(struct message *result, struct mess
 /// @param[in] etargs Pointer to evaluation arguments
 extern void clear_thread_args(struct eval_thread_args *etargs);
 
+/// Initialize a task group
+/// @param[out] group Task group
+void task_group_init(struct task_group *group);
+
+/// Clear a task group, all of its tasks must be finished
+/// @param[in,out] group Task group
+void task_group_clear(struct task_group *group);
+
+/// Start the worker threads of a thread pool
+/// @param[out] pool Thread pool
+/// @param[in] n_threads Amount of worker threads, 0 for one per online processor
+void thread_pool_init(struct thread_pool *pool, unsigned int n_threads);
+
+/// Finish all queued tasks, stop the worker threads and free the pool
+/// @param[in,out] pool Thread pool
+void thread_pool_clear(struct thread_pool *pool);
+
+/// Submit a task; tasks submitted from a worker go to its own deque, others are distributed round robin
+/// @param[in,out] pool Thread pool
+/// @param[in,out] group Task group of the task, may be NULL
+/// @param[in] func Function executed by a worker
+/// @param[in] arg Argument passed to func
+void thread_pool_submit(struct thread_pool *pool, struct task_group *group, void (*func)(void *arg), void *arg);
+
+/// Run one queued task of the pool in the calling thread, used by threads waiting for results
+/// @param[in,out] pool Thread pool
+/// @return 1 if a task was run, 0 if no task was queued
+int thread_pool_help(struct thread_pool *pool);
+
+/// Wait until all tasks of a group are finished
+/// The calling thread executes queued tasks of the pool while waiting, waiting from inside a task is therefore allowed
+/// @param[in,out] pool Thread pool
+/// @param[in,out] group Task group
+void thread_pool_wait(struct thread_pool *pool, struct task_group *group);
+
+/// Wait until all tasks submitted to the pool are finished
+/// @param[in,out] pool Thread pool
+void thread_pool_barrier(struct thread_pool *pool);
+
+// Typed submits, seeded ciphertexts are expanded by the submitting thread, inputs may be shared between tasks
+// Messages must not be modified by other tasks until the task is finished
+
+/// Submit eval_add(result, message1, message2)
+/// @param[in,out] pool Thread pool
+/// @param[in,out] group Task group, may be NULL
+/// @param[out] result Result
+/// @param[in] message1 Ciphertext 1
+/// @param[in] message2 Ciphertext 2
+void thread_pool_submit_eval_add(struct thread_pool *pool, struct task_group *group, struct message *result,
+                                 struct message *message1, struct message *message2);
+
+/// Submit eval_mul(result, message1, message2)
+/// @param[in,out] pool Thread pool
+/// @param[in,out] group Task group, may be NULL
+/// @param[out] result Result
+/// @param[in] message1 Ciphertext 1
+/// @param[in] message2 Ciphertext 2
+void thread_pool_submit_eval_mul(struct thread_pool *pool, struct task_group *group, struct message *result,
+                                 struct message *message1, struct message *message2);
+
+/// Submit message_relinearize(message, key_eval)
+/// @param[in,out] pool Thread pool
+/// @param[in,out] group Task group, may be NULL
+/// @param[in,out] message Ciphertext
+/// @param[in] key_eval Evaluation key
+void thread_pool_submit_relinearize(struct thread_pool *pool, struct task_group *group, struct message *message,
+                                    struct key_eval *key_eval);
+
+/// Submit encrypt(message, m, key)
+/// @param[in,out] pool Thread pool
+/// @param[in,out] group Task group, may be NULL
+/// @param[out] message Ciphertext initialized with message_init
+/// @param[in] m Plaintext, must stay valid until the task is finished
+/// @param[in] key Key
+void thread_pool_submit_encrypt(struct thread_pool *pool, struct task_group *group, struct message *message,
+                                const struct plwe_poly *m, const struct key *key);
+
+/// Submit decrypt(m, message, key)
+/// @param[in,out] pool Thread pool
+/// @param[in,out] group Task group, may be NULL
+/// @param[out] m Plaintext, initialized with plwe_poly_init
+/// @param[in] message Ciphertext
+/// @param[in] key Key
+void thread_pool_submit_decrypt(struct thread_pool *pool, struct task_group *group, struct plwe_poly *m,
+                                struct message *message, const struct key *key);
+
+/// Multiply two ciphertexts using the workers of a pool, the result equals eval_mul
+/// All cIndex1 * cIndex2 component products are computed in parallel, then every output element is accumulated
+/// (in a fixed order) and reduced by a single task; may be called from inside a task
+/// @param[in,out] pool Thread pool, NULL to multiply in the calling thread
+/// @param[out] result Result of the operation
+/// @param[in] message1 Ciphertext 1
+/// @param[in] message2 Ciphertext 2
+void eval_mul_parallel(struct thread_pool *pool, struct message *result, const struct message *message1,
+                       const struct message *message2);
+
 #endif //CUSTOM_THREADING_H
@@ -1,10 +1,18 @@
 #include "util.h"
 
+#include "instrument.h"
+#include "prime_table.h"
+#include "primes.h"
+
+#include <flint/fmpz_vec.h>
+
 #ifdef LIB_SODIUM
 #include <sodium.h>         // For random numbers
 #endif
 #ifndef LIB_SODIUM
 //#include <stdio.h>          // For reading urandom
+#include <stdint.h>         // For the ChaCha20 state
+#include <string.h>
 #endif
 
 /// Compute the amount of blocks required for certain bit- and blocksize
@@ -17,12 +25,14 @@ static inline __attribute__((always_inline)) unsigned long bits_to_blocks(unsign
 
 #ifdef LIB_SODIUM
 void urandom(unsigned int data[], unsigned long count){
+    INSTRUMENT_COUNT(counter_random_bytes, count * INT_SIZE);
     randombytes_buf(data, count * INT_SIZE);
 }
 #endif
 #ifndef LIB_SODIUM
 void urandom(unsigned int data[], unsigned long count)
 {
+    INSTRUMENT_COUNT(counter_random_bytes, count * INT_SIZE);
     FILE *fp;
     fp = fopen("/dev/urandom", "r");
     fread(data, INT_SIZE, count, fp);  //Read count * 4 Byte
@@ -30,6 +40,81 @@ void urandom(unsigned int data[], unsigned long count)
 }
 #endif
 
+#ifdef LIB_SODIUM
+void urandom_seed(unsigned char seed[SEED_SIZE]){
+    INSTRUMENT_COUNT(counter_random_bytes, SEED_SIZE);
+    randombytes_buf(seed, SEED_SIZE);
+}
+
+void urandom_seeded(unsigned char data[], unsigned long count, const unsigned char seed[SEED_SIZE]){
+    INSTRUMENT_COUNT(counter_random_bytes, count);
+    randombytes_buf_deterministic(data, count, seed);
+}
+#endif
+#ifndef LIB_SODIUM
+void urandom_seed(unsigned char seed[SEED_SIZE]){
+    INSTRUMENT_COUNT(counter_random_bytes, SEED_SIZE);
+    FILE *fp;
+    fp = fopen("/dev/urandom", "r");
+    fread(seed, 1, SEED_SIZE, fp);
+    fclose(fp);
+}
+
+#define CHACHA_ROTL(x, c) (((x) << (c)) | ((x) >> (32 - (c))))
+#define CHACHA_QR(a, b, c, d) \
+    a += b; d ^= a; d = CHACHA_ROTL(d, 16); \
+    c += d; b ^= c; b = CHACHA_ROTL(b, 12); \
+    a += b; d ^= a; d = CHACHA_ROTL(d, 8);  \
+    c += d; b ^= c; b = CHACHA_ROTL(b, 7)
+
+/// Load a 32 bit little endian word
+static inline __attribute__((always_inline)) uint32_t load32_le(const unsigned char *in){
+    return (uint32_t) in[0] | ((uint32_t) in[1] << 8) | ((uint32_t) in[2] << 16) | ((uint32_t) in[3] << 24);
+}
+
+void urandom_seeded(unsigned char data[], unsigned long count, const unsigned char seed[SEED_SIZE]){
+    INSTRUMENT_COUNT(counter_random_bytes, count);
+
+    //IETF ChaCha20 keystream with key=seed, nonce="LibsodiumDRG", counter=0 like randombytes_buf_deterministic
+    static const unsigned char nonce[12] = "LibsodiumDRG";
+    uint32_t state[16], x[16];
+
+    state[0] = 0x61707865;
+    state[1] = 0x3320646e;
+    state[2] = 0x79622d32;
+    state[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) {
+        state[4 + i] = load32_le(seed + 4 * i);
+    }
+    state[12] = 0;
+    for (int i = 0; i < 3; i++) {
+        state[13 + i] = load32_le(nonce + 4 * i);
+    }
+
+    for (unsigned long offset = 0; offset < count; offset += 64) {
+        memcpy(x, state, sizeof(x));
+
+        for (int round = 0; round < 10; round++) {
+            CHACHA_QR(x[0], x[4], x[8], x[12]);
+            CHACHA_QR(x[1], x[5], x[9], x[13]);
+            CHACHA_QR(x[2], x[6], x[10], x[14]);
+            CHACHA_QR(x[3], x[7], x[11], x[15]);
+            CHACHA_QR(x[0], x[5], x[10], x[15]);
+            CHACHA_QR(x[1], x[6], x[11], x[12]);
+            CHACHA_QR(x[2], x[7], x[8], x[13]);
+            CHACHA_QR(x[3], x[4], x[9], x[14]);
+        }
+
+        for (unsigned long i = 0; i < 64 && offset + i < count; i++) {
+            uint32_t word = x[i / 4] + state[i / 4];
+            data[offset + i] = (unsigned char) (word >> (8 * (i % 4)));
+        }
+
+        state[12] += 1;
+    }
+}
+#endif
+
 void get_random(mpz_t random, unsigned long bits){
     unsigned long block_count = bits_to_blocks(bits, 4);  // use integer array (4 bytes/block)
     unsigned int data[block_count];
@@ -64,32 +149,57 @@ void generate_prime(fmpz_t prime, unsigned long bits){
     } while (mpz_sizeinbase(data, 2) != bits);  // repeat until used prime bits match bitsize
 
     fmpz_set_mpz(prime, data);
+    mpz_clear(data);
 }
 
 void generate_prime_congruent_mod_2n(fmpz_t prime, unsigned long bits, unsigned long n){
-    generate_prime(prime, bits);
+    //Precomputed for common n and bit-sizes
+    if ((n & (n - 1)) == 0 && prime_table_lookup(prime, NULL, n_sizeinbase(n, 2) - 1, bits) == 0) {
+        return;
+    }
 
-    mpz_t one, two_n, p;
-    mpz_init_set_ui(one, 1);
-    mpz_init_set_ui(two_n, n << 1);
+    mpz_t start, p;
+    mpz_init(start);
     mpz_init(p);
 
-    fmpz_get_mpz(p, prime);
-
-    while (mpz_congruent_p(one, p, two_n) == 0) {
-        mpz_nextprime(p, p);
-    }
+    //Smallest prime k * 2n + 1 of the bit-size, cached across runs
+    mpz_setbit(start, bits - 1);
+    prime_search_congruent(p, start, n << 1);
 
     fmpz_set_mpz(prime, p);
 
-    mpz_clear(one);
-    mpz_clear(two_n);
+    mpz_clear(start);
     mpz_clear(p);
 }
 
+/// Generate a random large prime of a certain bit-size where prime = residue mod t
+/// @param[out] prime Empty FLINT Arbitrary precision integer to take random prime
+/// @param[in] bits Bit-size
+/// @param[in] residue Required residue mod t
+/// @param[in] t Modulus of the congruence
+static void generate_prime_congruent_mod_t(fmpz_t prime, unsigned long bits, unsigned long residue, unsigned long t){
+    mpz_t data;
+    mpz_init2(data, bits);
+
+    do {
+        get_random(data, bits);
+        mpz_setbit(data, bits - 1);                         // force bit-size
+        mpz_sub_ui(data, data, mpz_fdiv_ui(data, t));       // data = 0 mod t
+        mpz_add_ui(data, data, residue);                    // data = residue mod t
+
+        while (mpz_sizeinbase(data, 2) == bits && mpz_probab_prime_p(data, 25) == 0) {
+            mpz_add_ui(data, data, t);
+        }
+    } while (mpz_sizeinbase(data, 2) != bits);  // repeat if the search ran over the bit-size
+
+    fmpz_set_mpz(prime, data);
+
+    mpz_clear(data);
+}
+
 void settings_init(struct settings *settings, unsigned long n_power, fmpz_t q, unsigned long t, signed int b, unsigned long D) {
     settings->n = 1 << n_power;  // n must be a power of 2
-    fmpz_set(settings->q, q);
+    fmpz_init_set(settings->q, q);
     settings->qBits = fmpz_sizeinbase(q, 2);
     settings->t = t;  // t must be co-prime to q (always true for all t<q since q is prime)
     settings->b = b;
@@ -97,6 +207,45 @@ void settings_init(struct settings *settings, unsigned long n_power, fmpz_t q, u
 
     settings->std_dev = gen_std_deviation(settings->n);
     settings->greater_std_dev = gen_greater_std_deviation((double) settings->std_dev, settings->n);
+
+    settings->q_chain = NULL;
+    settings->q_chain_len = 0;
+
+    settings->encoding = encoding_standard;
+    settings->secret_dist = secret_gauss;
+    settings->hw = 0;
+    settings->T = 0;
+}
+
+void settings_init_mod_chain(struct settings *settings, unsigned long levels, unsigned long bits_step) {
+    unsigned long t_bits = n_sizeinbase(settings->t, 2);
+
+    if (bits_step == 0 || levels * bits_step + t_bits + 2 > settings->qBits) {
+        printf("Error. Modulus chain does not fit below q (qBits: %ld, levels: %ld, bits_step: %ld).\n",
+               settings->qBits, levels, bits_step);
+        return;
+    }
+
+    settings_clear_mod_chain(settings);
+
+    settings->q_chain_len = levels + 1;
+    settings->q_chain = _fmpz_vec_init((signed long) settings->q_chain_len);
+    fmpz_set(&settings->q_chain[0], settings->q);
+
+    unsigned long residue = fmpz_fdiv_ui(settings->q, settings->t);  //q_i = q mod t keeps m mod t while switching
+
+    for (unsigned long i = 1; i <= levels; i++) {
+        generate_prime_congruent_mod_t(&settings->q_chain[i], settings->qBits - i * bits_step, residue, settings->t);
+    }
+}
+
+void settings_clear_mod_chain(struct settings *settings) {
+    if (settings->q_chain != NULL) {
+        _fmpz_vec_clear(settings->q_chain, (signed long) settings->q_chain_len);
+    }
+
+    settings->q_chain = NULL;
+    settings->q_chain_len = 0;
 }
 
 int settings_check(const struct settings settings)
@@ -147,6 +296,26 @@ void settings_print(const struct settings settings) {
     printf("t: %ld\n", settings.t);
     printf("b: %d\n", settings.b);
     printf("D: %ld\n", settings.D);
+    if (settings.T != 0) {
+        printf("T: %d\n", settings.T);
+    }
+    printf("encoding: %s\n", settings.encoding == encoding_balanced ? "balanced" : "standard");
+
+    if (settings.secret_dist == secret_ternary) {
+        printf("secret: ternary\n");
+    }
+    else if (settings.secret_dist == secret_hamming) {
+        printf("secret: ternary, hw %ld\n", settings.hw);
+    }
+    else {
+        printf("secret: gauss\n");
+    }
+
+    for (unsigned long i = 1; i < settings.q_chain_len; i++) {
+        printf("q_%ld: ", i);
+        fmpz_print(&settings.q_chain[i]);
+        printf("\n");
+    }
 
     printf("----------------------------------\n");
 }
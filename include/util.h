@@ -3,9 +3,21 @@
 
 #define INT_SIZE 4          // sizeof(int)
 #define INT_BIT_SIZE 32     // sizeof(int) * 8
+#define SEED_SIZE 32        // Bytes of a seed for deterministic random data
 
 #include <flint/fmpz_poly.h>
 
+enum encoding_mode {
+    encoding_standard = 0,  // Digits in [0, b)
+    encoding_balanced = 1,  // Digits in (-b/2, b/2], non-adjacent form for b = 2
+};
+
+enum secret_dist {
+    secret_gauss = 0,       // Gaussian with std_dev
+    secret_ternary = 1,     // Uniform in {-1, 0, 1}
+    secret_hamming = 2,     // Exactly hw coefficients in {-1, 1}, all others 0
+};
+
 struct settings {
     signed long n;     // Degree of polynomials
     fmpz_t q;               // Large prime
@@ -15,6 +27,12 @@ struct settings {
     unsigned long D;            // Ciphertext max_len/Maximum degree of homomorphism
     double std_dev;         // Standard deviation of gaussian distribution
     double greater_std_dev; // Greater standard deviation of gaussian distribution
+    fmpz *q_chain;          // Modulus chain q = q_0 > q_1 > ... for modulus switching (NULL if not generated)
+    unsigned long q_chain_len;  // Amount of moduli in the chain (including q)
+    enum encoding_mode encoding;    // Digit representation used for encoding
+    enum secret_dist secret_dist;   // Distribution of the secret key and the ephemeral v of encrypt
+    unsigned long hw;               // Hamming weight for secret_hamming
+    int T;                          // Base of the evaluation key (key_init_eval), 0 if products are not relinearized
 };
 
 /// Fetch count * 32 random bits
@@ -24,6 +42,16 @@ struct settings {
 /// @param[in] count Amount of 4 byte blocks to fetch
 void urandom(unsigned int data[], unsigned long count);
 
+/// Fetch a random seed
+/// @param[out] seed Seed
+void urandom_seed(unsigned char seed[SEED_SIZE]);
+
+/// Expand a seed into count deterministic random bytes (ChaCha20, same output as libsodium)
+/// @param[out] data Empty array of size >= count
+/// @param[in] count Amount of bytes
+/// @param[in] seed Seed
+void urandom_seeded(unsigned char data[], unsigned long count, const unsigned char seed[SEED_SIZE]);
+
 /// Get n bit random values
 /// @param[out] random Empty Arbitrary precision integer to take random data
 /// @param[in] bits Amount of bits
@@ -34,9 +62,10 @@ void get_random(mpz_t random, unsigned long bits);
 /// @param[in] bits Bit-size
 void generate_prime(fmpz_t prime, unsigned long bits);
 
-/// Generate a random large prime of a certain bit-size where 1 = q mod 2n
-/// @param[out] prime Empty FLINT Arbitrary precision integer to take random prime
-/// @param[in] bits Minimum bit-size
+/// Generate the smallest prime of a certain bit-size where 1 = q mod 2n, taken from the prime table (see
+/// prime_table_lookup) if available and searched otherwise (see prime_search_congruent)
+/// @param[out] prime Empty FLINT Arbitrary precision integer to take the prime
+/// @param[in] bits Bit-size
 /// @param[in] n Polynomial degree n
 void generate_prime_congruent_mod_2n(fmpz_t prime, unsigned long bits, unsigned long n);
 
@@ -49,6 +78,17 @@ void generate_prime_congruent_mod_2n(fmpz_t prime, unsigned long bits, unsigned
 /// @param[in] D Maximum ciphertext length / maximum homomorphic depth minus 2
 void settings_init(struct settings *settings, unsigned long n_power, fmpz_t q, unsigned long t, signed int b, unsigned long D);
 
+/// Generate a modulus chain for modulus switching
+/// Every modulus q_i is a prime with q_i = q mod t, which keeps the plaintext intact when switching
+/// @param[in,out] settings Settings with q and t already set
+/// @param[in] levels Amount of moduli to generate below q
+/// @param[in] bits_step Bit-size difference between two neighbouring moduli
+void settings_init_mod_chain(struct settings *settings, unsigned long levels, unsigned long bits_step);
+
+/// Clear modulus chain (free memory)
+/// @param[in,out] settings Settings
+void settings_clear_mod_chain(struct settings *settings);
+
 /// Check settings for errors
 /// @param[in] settings Settings
 /// @return 0 if struct is ok, != 0 otherwise
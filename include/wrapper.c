@@ -3,16 +3,33 @@
 #include "asym.h"
 #include "encoding.h"
 #include "plwe_poly.h"
+#include "prime_table.h"
 #include "util.h"
 #include "message.h"
 
 #include <flint/fmpz_poly.h>
 
+/// Encode a signed integer with the encoding mode of the settings
+/// @param[out] output Polynomial
+/// @param[in] input Integer
+/// @param[in] settings Settings
+static void encode_settings(struct plwe_poly *output, signed long input, const struct settings *settings) {
+    if (settings->encoding == encoding_balanced) {
+        encode_si_balanced(output, input, settings->b);
+    }
+    else {
+        encode_si(output, input, settings->b);
+    }
+}
+
 void settings_init_gen_prime(struct settings *settings, unsigned long n_power, unsigned long qBits, unsigned long t, signed int b, unsigned long D) {
     fmpz_t q;
     fmpz_init(q);
 
-    generate_prime(q, qBits);
+    //Prefer a precomputed prime for reproducible parameters
+    if (prime_table_lookup(q, NULL, n_power, qBits) != 0) {
+        generate_prime(q, qBits);
+    }
     settings_init(settings, n_power, q, t, b, D);
 
     fmpz_clear(q);
@@ -22,65 +39,112 @@ void settings_init_gen_prime_congruent_mod_2n(struct settings *settings, unsigne
     fmpz_t q;
     fmpz_init(q);
 
-    generate_prime_congruent_mod_2n(q, qBits, settings->n);
+    generate_prime_congruent_mod_2n(q, qBits, 1UL << n_power);
     settings_init(settings, n_power, q, t, b, D);
 
     fmpz_clear(q);
 }
 
 void encode_encrypt(struct message *output, signed long input, const struct settings *settings, const struct key *key){
-    mpz_t in;
-    mpz_init_set_si(in, input);
-
     struct plwe_poly poly;
     plwe_poly_init(&poly, settings->q, settings->n);
 
-    encode(&poly, in, settings->b);
+    encode_settings(&poly, input, settings);
     encrypt(output, &poly, key);
 
     plwe_poly_clear(&poly);
-    mpz_clear(in);
 }
 
-signed int decrypt_decode(struct message *input, const struct settings *settings, const struct key *key){
-    mpz_t out;
-    mpz_init(out);
+void encode_encrypt_sym(struct message *output, signed long input, const struct settings *settings, const struct key *key){
+    struct plwe_poly poly;
+    plwe_poly_init(&poly, settings->q, settings->n);
+
+    encode_settings(&poly, input, settings);
+    encrypt_sym_seeded(output, &poly, key);
 
+    plwe_poly_clear(&poly);
+}
+
+signed long decrypt_decode(struct message *input, const struct settings *settings, const struct key *key){
     struct plwe_poly poly;
     plwe_poly_init(&poly, settings->q, settings->n);
 
     decrypt(&poly, input, key);
-    decode(out, &poly, settings->b);
+    signed long ret = decode_si(&poly, settings->b);
 
-    signed int ret = mpz_get_si(out);
-    mpz_clear(out);
+    plwe_poly_clear(&poly);
 
     return ret;
+}
+
+int encode_encrypt_batch(struct message *output, const signed long *input, unsigned long count, const struct settings *settings, const struct key *key){
+    struct plwe_poly poly;
+    plwe_poly_init(&poly, settings->q, settings->n);
+
+    int ret = encode_batch(&poly, input, count, settings->t);
+    if (ret == 0) {
+        encrypt(output, &poly, key);
+    }
+
+    plwe_poly_clear(&poly);
 
+    return ret;
 }
 
-void encode_eval_add_plain(struct message *output, struct message *message, const signed long plain, const struct settings *settings) {
-    mpz_t in;
-    mpz_init_set_si(in, plain);
+int decrypt_decode_batch(signed long *output, struct message *input, const struct settings *settings, const struct key *key){
+    struct plwe_poly poly;
+    plwe_poly_init(&poly, settings->q, settings->n);
+
+    decrypt(&poly, input, key);
+    int ret = decode_batch(output, &poly, settings->t);
 
+    plwe_poly_clear(&poly);
+
+    return ret;
+}
+
+int encode_encrypt_packed(struct message *output, const signed long *input, unsigned long count, unsigned long stride, const struct settings *settings, const struct key *key){
     struct plwe_poly poly;
     plwe_poly_init(&poly, settings->q, settings->n);
-    encode(&poly, in, settings->b);
+
+    int ret = encode_packed(&poly, input, count, stride, settings->b);
+    if (ret == 0) {
+        encrypt(output, &poly, key);
+    }
+
+    plwe_poly_clear(&poly);
+
+    return ret;
+}
+
+int decrypt_decode_packed(signed long *output, struct message *input, unsigned long count, unsigned long stride, const struct settings *settings, const struct key *key){
+    struct plwe_poly poly;
+    plwe_poly_init(&poly, settings->q, settings->n);
+
+    decrypt(&poly, input, key);
+    int ret = decode_packed(output, &poly, count, stride, settings->b);
+
+    plwe_poly_clear(&poly);
+
+    return ret;
+}
+
+void encode_eval_add_plain(struct message *output, struct message *message, const signed long plain, const struct settings *settings) {
+    struct plwe_poly poly;
+    plwe_poly_init(&poly, settings->q, settings->n);
+    encode_settings(&poly, plain, settings);
 
     eval_add_plain(output, message, &poly);
 
-    mpz_clear(in);
+    plwe_poly_clear(&poly);
 }
 
 void encode_eval_mul_plain(struct message *output, struct message *message, const signed long plain, const struct settings *settings) {
-    mpz_t in;
-    mpz_init_set_si(in, plain);
-
     struct plwe_poly poly;
     plwe_poly_init(&poly, settings->q, settings->n);
-    encode(&poly, in, settings->b);
+    encode_settings(&poly, plain, settings);
 
     eval_mul_plain(output, message, &poly);
 
-    mpz_clear(in);
+    plwe_poly_clear(&poly);
 }
@@ -8,7 +8,8 @@ struct settings;    /// defined in util.h
 struct plwe_poly;   /// defined in plwe_poly.h
 
 
-/// Generate a random large prime of a certain bit-size and fill settings with parameters
+/// Take a prime of a certain bit-size from the prime table (see prime_table_lookup) and fill settings with parameters
+/// A random large prime is generated if the table has no prime for n and qBits
 /// @param[out] settings Empty settings
 /// @param[in] n_power Power of n
 /// @param[in] qBits Bit size of q
@@ -17,7 +18,8 @@ struct plwe_poly;   /// defined in plwe_poly.h
 /// @param[in] D Maximum ciphertext length / maximum homomorphic depth minus 2
 void settings_init_gen_prime(struct settings *settings, unsigned long n_power, unsigned long qBits, unsigned long t, signed int b, unsigned long D);
 
-/// Generate a random large prime congruent mod 2n of a certain bit-size and fill settings with parameters
+/// Take or generate a prime congruent 1 mod 2n of a certain bit-size and fill settings with parameters
+/// (see generate_prime_congruent_mod_2n)
 /// @param[out] settings Empty settings
 /// @param[in] n_power Power of n
 /// @param[in] qBits Bit size of q
@@ -33,12 +35,56 @@ void settings_init_gen_prime_congruent_mod_2n(struct settings *settings, unsigne
 /// @param[in] key Key
 void encode_encrypt(struct message *output, signed long input, const struct settings *settings, const struct key *key);
 
+/// Encode and encrypt a signed integer symmetrically with the secret key (seeded half-size ciphertext)
+/// @param[out] output Ciphertext
+/// @param[in] input Plaintext
+/// @param[in] settings Settings
+/// @param[in] key Key
+void encode_encrypt_sym(struct message *output, signed long input, const struct settings *settings, const struct key *key);
+
 /// Decrypt and decode a ciphertext
 /// @param[in] input Ciphertext
 /// @param[in] settings Settings
 /// @param[in] key Key
 /// @return Plaintext
-signed int decrypt_decode(struct message *input, const struct settings *settings, const struct key *key);
+signed long decrypt_decode(struct message *input, const struct settings *settings, const struct key *key);
+
+/// Encode a vector of signed integers into the slots of a plaintext and encrypt it (t must be a prime with t = 1 mod 2n)
+/// @param[out] output Ciphertext
+/// @param[in] input Plaintexts
+/// @param[in] count Amount of plaintexts (<= n)
+/// @param[in] settings Settings
+/// @param[in] key Key
+/// @return 0 if ok, != 0 if t does not allow batching
+int encode_encrypt_batch(struct message *output, const signed long *input, unsigned long count, const struct settings *settings, const struct key *key);
+
+/// Decrypt a ciphertext and decode all n slots
+/// @param[out] output Array of size >= n
+/// @param[in] input Ciphertext
+/// @param[in] settings Settings
+/// @param[in] key Key
+/// @return 0 if ok, != 0 if t does not allow batching
+int decrypt_decode_batch(signed long *output, struct message *input, const struct settings *settings, const struct key *key);
+
+/// Encode multiple signed integers into one plaintext (coefficient packing) and encrypt it
+/// @param[out] output Ciphertext
+/// @param[in] input Plaintexts
+/// @param[in] count Amount of plaintexts (count * stride <= n)
+/// @param[in] stride Coefficient stride (see packing_stride)
+/// @param[in] settings Settings
+/// @param[in] key Key
+/// @return 0 if ok, != 0 if the plaintexts do not fit
+int encode_encrypt_packed(struct message *output, const signed long *input, unsigned long count, unsigned long stride, const struct settings *settings, const struct key *key);
+
+/// Decrypt a ciphertext and decode all packed integers
+/// @param[out] output Array of size >= count
+/// @param[in] input Ciphertext
+/// @param[in] count Amount of packed integers
+/// @param[in] stride Coefficient stride used for encoding
+/// @param[in] settings Settings
+/// @param[in] key Key
+/// @return 0 if ok, != 0 if the plaintexts do not fit
+int decrypt_decode_packed(signed long *output, struct message *input, unsigned long count, unsigned long stride, const struct settings *settings, const struct key *key);
 
 /// Encode and add a signed integer to a ciphertext
 /// @param[out] output Ciphertext result of the addition
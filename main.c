@@ -4,9 +4,17 @@
 
 #include "asym.h"
 #include "binary_tree.h"
+#include "cost.h"
 #include "dist.h"
+#include "encoding.h"
+#include "future.h"
+#include "instrument.h"
 #include "key.h"
 #include "message.h"
+#include "plain.h"
+#include "prime_table.h"
+#include "serialize.h"
+#include "tape.h"
 #include "threading.h"
 #include "util.h"
 #include "wrapper.h"
@@ -16,6 +24,16 @@
 #include <sys/time.h>
 
 //Helper functions
+static void set_node(struct node *node, enum node_type type, int M, struct node *left_node, struct node *right_node) {
+    node->inf_norm = 0;
+    node->degree = 0;
+    node->type = type;
+    node->M = M;
+    node->message = NULL;
+    node->left_node = left_node;
+    node->right_node = right_node;
+}
+
 static void stopwatch() {
     static bool started = false;
     static struct timeval t1, t2;
@@ -109,8 +127,8 @@ void encrypt_eval_decrypt(){
     eval_add(&enc1, &enc1, &enc1);  //Compute - 1800 - 1800 = - 3600
 
     //Decrypt
-    signed int result = decrypt_decode(&enc1, &settings, &key);
-    printf("Result: %d\n", result);
+    signed long result = decrypt_decode(&enc1, &settings, &key);
+    printf("Result: %ld\n", result);
 
     //Cleanup
     message_clear(&enc1);
@@ -155,14 +173,164 @@ void encrypt_eval_relin_decrypt(){
 
     //Decrypt
     printf("Decrypt...\n");
-    signed int result = decrypt_decode(&enc1, &settings, &key);
-    printf("Result: %d\n", result);
+    signed long result = decrypt_decode(&enc1, &settings, &key);
+    printf("Result: %ld\n", result);
 
     //Cleanup
     message_clear(&enc1);
     message_clear(&enc2);
 }
 
+void encrypt_eval_mod_switch_decrypt(){
+    //Settings
+    struct settings settings;
+    settings_init_gen_prime(&settings, 10, 200, 2000, 10, 4);
+    settings_init_mod_chain(&settings, 2, 50);     //q_1 with 150 bits, q_2 with 100 bits
+
+    //Keygen
+    struct key key;
+    keygen(&key, &settings);
+
+    //Encrypt
+    struct message enc1, enc2;
+    message_init(&enc1, &settings);
+    message_init(&enc2, &settings);
+
+    encode_encrypt(&enc1, 7, &settings, &key);          //Encrypt integer 7
+    encode_encrypt(&enc2, 6, &settings, &key);          //Encrypt integer 6
+
+    //Eval
+    eval_mul(&enc1, &enc1, &enc2);                            //Compute 7 * 6 = 42
+
+    //Switch to the smallest modulus
+    message_mod_switch(&enc1, &settings, 2);
+
+    //Decrypt
+    signed long result = decrypt_decode(&enc1, &settings, &key);
+    printf("Result: %ld\n", result);
+
+    //Cleanup
+    message_clear(&enc1);
+    message_clear(&enc2);
+    settings_clear_mod_chain(&settings);
+}
+
+void encrypt_sym_serialize_decrypt(){
+    //Settings
+    struct settings settings;
+    settings_init_gen_prime(&settings, 10, 200, 2000, 10, 4);
+
+    //Keygen
+    struct key key;
+    keygen(&key, &settings);
+
+    //Encrypt with the secret key, c1 is only stored as seed
+    struct message enc1, enc2;
+    message_init(&enc1, &settings);
+    message_init(&enc2, &settings);
+
+    encode_encrypt_sym(&enc1, 7, &settings, &key);      //Encrypt integer 7
+
+    //Transmit
+    message_save(&enc1, "ciphertext.bin");
+    message_load(&enc2, &settings, "ciphertext.bin", 0);
+    printf("Serialized size: %zu bytes\n", message_serialized_size(&enc2));
+
+    //Eval, reads c1 of the seeded inputs from expanded temporary copies
+    eval_mul(&enc2, &enc2, &enc1);                            //Compute 7 * 7 = 49
+
+    //Decrypt
+    signed long result = decrypt_decode(&enc2, &settings, &key);
+    printf("Result: %ld\n", result);
+
+    //Cleanup
+    message_clear(&enc1);
+    message_clear(&enc2);
+}
+
+void encrypt_eval_batch_decrypt(){
+    //Settings, batching requires a prime t = 1 mod 2n
+    struct settings settings;
+    settings_init_gen_prime(&settings, 10, 200, batch_modulus(20, 1 << 10), 10, 4);
+
+    //Keygen
+    struct key key;
+    keygen(&key, &settings);
+
+    //Encrypt n values per ciphertext
+    signed long *values1 = malloc(settings.n * sizeof(signed long));
+    signed long *values2 = malloc(settings.n * sizeof(signed long));
+    signed long *results = malloc(settings.n * sizeof(signed long));
+
+    for (signed long i = 0; i < settings.n; i++) {
+        values1[i] = i;
+        values2[i] = -3;
+    }
+
+    struct message enc1, enc2;
+    message_init(&enc1, &settings);
+    message_init(&enc2, &settings);
+
+    encode_encrypt_batch(&enc1, values1, settings.n, &settings, &key);
+    encode_encrypt_batch(&enc2, values2, settings.n, &settings, &key);
+
+    //Eval
+    eval_mul(&enc1, &enc1, &enc2);                            //Compute i * -3 in every slot
+
+    //Decrypt
+    decrypt_decode_batch(results, &enc1, &settings, &key);
+    printf("Result: %ld %ld ... %ld\n", results[0], results[1], results[settings.n - 1]);
+
+    //Cleanup
+    message_clear(&enc1);
+    message_clear(&enc2);
+    free(values1);
+    free(values2);
+    free(results);
+}
+
+void encrypt_eval_packed_decrypt(){
+    //Settings
+    struct settings settings;
+    settings_init_gen_prime(&settings, 10, 100, 200000, 10, 4);
+
+    //Keygen
+    struct key key;
+    keygen(&key, &settings);
+
+    //Pack results < 100000, multiplied once with a scalar < 100
+    unsigned long stride = packing_stride(100000, 100, 1, settings.b);
+    unsigned long count = settings.n / stride;
+
+    signed long *values = malloc(count * sizeof(signed long));
+    signed long *results = malloc(count * sizeof(signed long));
+
+    for (unsigned long i = 0; i < count; i++) {
+        values[i] = (signed long) i;
+    }
+
+    struct message enc1, enc2;
+    message_init(&enc1, &settings);
+    message_init(&enc2, &settings);
+
+    encode_encrypt_packed(&enc1, values, count, stride, &settings, &key);
+    encode_encrypt_packed(&enc2, values, count, stride, &settings, &key);
+
+    //Eval
+    eval_add(&enc1, &enc1, &enc2);                            //Compute i + i
+    encode_eval_mul_plain(&enc1, &enc1, 50, &settings);       //Compute 2i * 50
+
+    //Decrypt
+    decrypt_decode_packed(results, &enc1, count, stride, &settings, &key);
+    printf("Result (%ld values): %ld %ld ... %ld\n", count, results[0], results[1], results[count - 1]);
+
+    //Cleanup
+    message_clear(&enc1);
+    message_clear(&enc2);
+    free(values);
+    free(results);
+}
+
 void encrypt_eval_plain_decrypt(){
     //Settings
     struct settings settings;
@@ -189,8 +357,8 @@ void encrypt_eval_plain_decrypt(){
     encode_eval_mul_plain(&enc1, &enc1, 2, &settings); //Compute -3598 * 2 = -7196
 
     //Decrypt
-    signed int result = decrypt_decode(&enc1, &settings, &key);
-    printf("Result: %d\n", result);
+    signed long result = decrypt_decode(&enc1, &settings, &key);
+    printf("Result: %ld\n", result);
 
     //Cleanup
     message_clear(&enc1);
@@ -237,8 +405,8 @@ static void threaded_addition() {
     eval_add(&enc1, &enc1, &enc3);                                             //2+12=14
 
     //Decrypt
-    signed int result = decrypt_decode(&enc1, &settings, &key);
-    printf("Result: %d\n", result);
+    signed long result = decrypt_decode(&enc1, &settings, &key);
+    printf("Result: %ld\n", result);
 
     //Cleanup
     clear_thread_args(args1);
@@ -249,21 +417,143 @@ static void threaded_addition() {
     message_clear(&enc4);
 }
 
-void time_measurement() {
+void thread_pool_evaluation() {
     //Settings
     struct settings settings;
+    settings_init_gen_prime(&settings, 10, 200, 2000, 10, 6);
 
-    fmpz_t q;
-    fmpz_init(q);
+    //Keygen
+    struct key key;
+    keygen(&key, &settings);
 
-    //generate_prime(q, 64);
-    //fmpz_print(q), printf("\n");
+    //Workers are started once and reused for every operation
+    struct thread_pool pool;
+    thread_pool_init(&pool, 0);
 
-    //Use static q
-    char a[] = "16556975737954184699";  //q, 64 bit
-    fmpz_set_str(q, a, 10);
-    settings_init(&settings, 14, q, 10000, 2, 4);
-    fmpz_clear(q);
+    //Encrypt
+    struct plwe_poly m[6];
+    struct message enc[6];
+    for (int i = 0; i < 6; i++) {
+        plwe_poly_init(&m[i], settings.q, settings.n);
+        encode_si(&m[i], i + 1, settings.b);
+        message_init(&enc[i], &settings);
+        thread_pool_submit_encrypt(&pool, NULL, &enc[i], &m[i], &key);
+    }
+    thread_pool_barrier(&pool);
+
+    //Eval
+    thread_pool_submit_eval_add(&pool, NULL, &enc[0], &enc[0], &enc[1]);    //1+2=3
+    thread_pool_submit_eval_add(&pool, NULL, &enc[2], &enc[2], &enc[3]);    //3+4=7
+    thread_pool_submit_eval_mul(&pool, NULL, &enc[4], &enc[4], &enc[5]);    //5*6=30
+    thread_pool_barrier(&pool);
+
+    thread_pool_submit_eval_mul(&pool, NULL, &enc[0], &enc[0], &enc[2]);    //3*7=21
+    thread_pool_barrier(&pool);
+
+    //Both ciphertexts have 3 elements, all 9 component products run in parallel
+    eval_mul_parallel(&pool, &enc[0], &enc[0], &enc[4]);                       //21*30=630
+
+    //Decrypt
+    signed long result = decrypt_decode(&enc[0], &settings, &key);
+    printf("Result: %ld\n", result);
+
+    //Cleanup
+    thread_pool_clear(&pool);
+    for (int i = 0; i < 6; i++) {
+        plwe_poly_clear(&m[i]);
+        message_clear(&enc[i]);
+    }
+}
+
+void async_evaluation() {
+    //Settings
+    struct settings settings;
+    settings_init_gen_prime(&settings, 10, 110, 2000, 10, 4);
+
+    //Keygen
+    struct key key;
+    keygen(&key, &settings);
+
+    struct key_eval key_eval;
+    key_init_eval(&key_eval, &key, 2);
+
+    struct thread_pool pool;
+    thread_pool_init(&pool, 0);
+
+    //Two independent requests (x * y and x + y), scheduled at once and overlapped by the pool
+    struct plwe_poly m[4];
+    struct message enc[4];
+    struct future *encrypted[4];
+    for (int i = 0; i < 4; i++) {
+        plwe_poly_init(&m[i], settings.q, settings.n);
+        encode_si(&m[i], i + 2, settings.b);
+        message_init(&enc[i], &settings);
+        encrypted[i] = encrypt_async(&pool, &enc[i], &m[i], &key, NULL, 0);
+    }
+
+    struct future *mul = eval_mul_async(&pool, &enc[0], &enc[0], &enc[1], encrypted, 2);   //2*3=6
+    struct future *relin = relinearize_async(&pool, &enc[0], &key_eval, &mul, 1);
+    struct future *add = eval_add_async(&pool, &enc[2], &enc[2], &enc[3], encrypted + 2, 2); //4+5=9
+
+    struct plwe_poly result[2];
+    plwe_poly_init(&result[0], settings.q, settings.n);
+    plwe_poly_init(&result[1], settings.q, settings.n);
+
+    struct future *decrypted[2];
+    decrypted[0] = decrypt_async(&pool, &result[0], &enc[0], &key, &relin, 1);
+    decrypted[1] = decrypt_async(&pool, &result[1], &enc[2], &key, &add, 1);
+
+    //Print the results in the order they finish
+    int printed[2] = {0, 0};
+    for (int i = 0; i < 2; i++) {
+        struct future *remaining[2];
+        int index[2];
+        int count = 0;
+
+        for (int j = 0; j < 2; j++) {
+            if (!printed[j]) {
+                remaining[count] = decrypted[j];
+                index[count++] = j;
+            }
+        }
+
+        int j = index[future_wait_any(remaining, count)];
+        printed[j] = 1;
+
+        if (future_status(decrypted[j]) == future_ok) {
+            printf("Result %d: %ld\n", j, decode_si(&result[j], settings.b));
+        }
+        else {
+            printf("Request %d failed with status %d\n", j, future_status(decrypted[j]));
+        }
+    }
+
+    //Cleanup
+    for (int i = 0; i < 4; i++) {
+        future_release(encrypted[i]);
+    }
+    future_release(mul);
+    future_release(relin);
+    future_release(add);
+    future_release(decrypted[0]);
+    future_release(decrypted[1]);
+
+    thread_pool_clear(&pool);
+    for (int i = 0; i < 4; i++) {
+        plwe_poly_clear(&m[i]);
+        message_clear(&enc[i]);
+    }
+    plwe_poly_clear(&result[0]);
+    plwe_poly_clear(&result[1]);
+    key_clear_eval(&key_eval);
+}
+
+void time_measurement() {
+    //Settings
+    struct settings settings;
+
+    //Precomputed 64 bit q = 1 mod 2n from the prime table
+    settings_init_gen_prime_congruent_mod_2n(&settings, 14, 64, 10000, 2, 4);
 
     //Keygen
     struct key key;
@@ -306,14 +596,77 @@ void time_measurement() {
     //Decrypt
     printf("Decrypt: ");
     stopwatch();
-    signed int result;
+    signed long result;
     for(int i = 0; i < 1; i++) {
         result = decrypt_decode(&enc1, &settings, &key);
     }
     stopwatch();
-    printf("Result: %d\n", result);
+    printf("Result: %ld\n", result);
+
+    //Cleanup
+    message_clear(&enc1);
+    message_clear(&enc2);
+}
+
+void encrypt_eval_plain_cached_decrypt(){
+    //Settings
+    struct settings settings;
+    settings_init_gen_prime(&settings, 10, 110, 2000, 10, 4);
+
+    //Keygen
+    struct key key;
+    keygen(&key, &settings);
+
+    //Encode the weight once, reuse it for all ciphertexts
+    struct plain weight;
+    plain_init_si(&weight, 12, &settings, plain_auto);
+
+    struct message enc[4];
+    for (int i = 0; i < 4; i++) {
+        message_init(&enc[i], &settings);
+        encode_encrypt(&enc[i], i - 2, &settings, &key);
+    }
+
+    //Eval
+    for (int i = 0; i < 4; i++) {
+        eval_mul_plain_enc(&enc[i], &enc[i], &weight);      //Compute (i - 2) * 12
+    }
+
+    //Decrypt
+    for (int i = 0; i < 4; i++) {
+        printf("Result: %ld\n", decrypt_decode(&enc[i], &settings, &key));
+        message_clear(&enc[i]);
+    }
 
     //Cleanup
+    plain_clear(&weight);
+}
+
+void encrypt_eval_sparse_secret_decrypt(){
+    //Settings
+    struct settings settings;
+    settings_init_gen_prime(&settings, 10, 110, 2000, 10, 4);
+    settings.secret_dist = secret_hamming;      //Sparse ternary secret, decrypt multiplies by shifts
+    settings.hw = 16;
+
+    //Keygen
+    struct key key;
+    keygen(&key, &settings);
+
+    //Encrypt
+    struct message enc1, enc2;
+    message_init(&enc1, &settings);
+    message_init(&enc2, &settings);
+
+    encode_encrypt(&enc1, 7, &settings, &key);
+    encode_encrypt(&enc2, -6, &settings, &key);
+
+    //Eval
+    eval_mul(&enc1, &enc1, &enc2);      //Compute 7 * (-6)
+
+    //Decrypt
+    printf("Result: %ld\n", decrypt_decode(&enc1, &settings, &key));
+
     message_clear(&enc1);
     message_clear(&enc2);
 }
@@ -329,14 +682,15 @@ void key_save_load(){
 
     char path[] = "outfile.dat";
 
-    plwe_poly_print(&k.sk);
+    plwe_poly_small_print(&k.sk);
     plwe_poly_print(&k.pk_a);
     plwe_poly_print(&k.pk_b);
 
-    key_save(&k, path);
-    key_load(&k2, path);
+    if (key_save(&k, path) != 0 || key_load(&k2, path) != 0) {
+        return;
+    }
 
-    plwe_poly_print(&k2.sk);
+    plwe_poly_small_print(&k2.sk);
     plwe_poly_print(&k2.pk_a);
     plwe_poly_print(&k2.pk_b);
 }
@@ -345,6 +699,7 @@ void my_treefunc(struct node *node , int rows, const int m[]) {
     //Initialize this node
     node->inf_norm = 0;
     node->degree = 0;
+    node->message = NULL;
 
     if (rows > 1) {
         node->M = 0;
@@ -379,7 +734,7 @@ void my_treefunc(struct node *node , int rows, const int m[]) {
         my_treefunc(node->left_node, rows - 1, m);
         node->left_node->M = m[0];
 
-        my_treefunc(node->left_node, rows - 1, m);
+        my_treefunc(node->right_node, rows - 1, m);
         node->right_node->M = m[1];
     }
     else if (rows == 1) {
@@ -395,11 +750,343 @@ void create_params_for_sample_tree(){
     const int m_len = 2;
     const int m[2] = {1,2};
 
-    create_tree_and_generate_params(&settings, my_treefunc, 4, m, m_len, 128, 20);
+    create_tree_and_generate_params(&settings, my_treefunc, 4, m, m_len, 128, 20, encoding_standard, NULL);
 
     settings_print(settings);
 }
 
+/// Encrypt leaf_values[i] into the i-th value node (from left to right)
+static void encrypt_leaves(struct node *node, struct message *leaves, const signed long *leaf_values, int *index, const struct settings *settings, const struct key *key) {
+    if (node->type == value) {
+        message_init(&leaves[*index], settings);
+        encode_encrypt(&leaves[*index], leaf_values[*index], settings, key);
+        node->message = &leaves[*index];
+        *index += 1;
+        return;
+    }
+
+    encrypt_leaves(node->left_node, leaves, leaf_values, index, settings, key);
+    encrypt_leaves(node->right_node, leaves, leaf_values, index, settings, key);
+}
+
+/// Free the nodes allocated by my_treefunc below node
+static void free_tree(struct node *node) {
+    if (node->left_node != NULL) {
+        free_tree(node->left_node);
+        free(node->left_node);
+    }
+
+    if (node->right_node != NULL) {
+        free_tree(node->right_node);
+        free(node->right_node);
+    }
+}
+
+void encrypt_eval_tree_decrypt(){
+    //The same tree description yields the parameters and the circuit
+    const int m_len = 2;
+    const int m[2] = {3, 4};
+    const int rows = 3;                 //Root, products, values
+
+    struct settings settings;
+    create_tree_and_generate_params(&settings, my_treefunc, rows, m, m_len, 128, 20, encoding_standard, NULL);
+
+    struct node root;
+    root.type = plus;
+    my_treefunc(&root, rows, m);
+
+    //Keygen
+    struct key key;
+    keygen(&key, &settings);
+
+    struct key_eval key_eval;
+    key_init_eval(&key_eval, &key, 2);
+
+    //Encrypt the leaves, (3 * 4) + (2 * 1)
+    const signed long leaf_values[4] = {3, 4, 2, 1};
+    struct message leaves[4];
+    int index = 0;
+    encrypt_leaves(&root, leaves, leaf_values, &index, &settings, &key);
+
+    //Eval, both products run in parallel and are relinearized
+    struct thread_pool pool;
+    thread_pool_init(&pool, 0);
+
+    struct message result;
+    message_init(&result, &settings);
+
+    if (evaluate_tree(&result, &root, &settings, &pool, &key_eval) == 0) {
+        printf("Result: %ld\n", decrypt_decode(&result, &settings, &key));
+    }
+
+    //Cleanup
+    thread_pool_clear(&pool);
+    message_clear(&result);
+    for (int i = 0; i < 4; i++) {
+        message_clear(&leaves[i]);
+    }
+    free_tree(&root);
+    key_clear_eval(&key_eval);
+}
+
+void encrypt_eval_rebalanced_chain_decrypt(){
+    //Settings
+    struct settings settings;
+    settings_init_gen_prime(&settings, 10, 200, 2000, 10, 4);
+
+    //Keygen
+    struct key key;
+    keygen(&key, &settings);
+
+    struct key_eval key_eval;
+    key_init_eval(&key_eval, &key, 2);
+
+    //Product chain ((((1 * 2) * 3) * 4) * 5) * 6, nodes[0] is the root
+    struct node nodes[11];
+    struct message leaves[6];
+
+    for (int i = 0; i < 6; i++) {
+        struct node *leaf = &nodes[5 + i];
+        leaf->type = value;
+        leaf->M = i + 1;
+        leaf->left_node = NULL;
+        leaf->right_node = NULL;
+
+        message_init(&leaves[i], &settings);
+        encode_encrypt(&leaves[i], i + 1, &settings, &key);
+        leaf->message = &leaves[i];
+    }
+
+    for (int i = 0; i < 5; i++) {
+        nodes[i].type = multiply;
+        nodes[i].message = NULL;
+        nodes[i].left_node = (i == 4) ? &nodes[5] : &nodes[i + 1];
+        nodes[i].right_node = &nodes[10 - i];
+    }
+
+    printf("Depth before: %ld\n", tree_depth(&nodes[0]));
+    tree_rebalance(&nodes[0]);
+    printf("Depth after: %ld\n", tree_depth(&nodes[0]));
+
+    //Eval
+    struct thread_pool pool;
+    thread_pool_init(&pool, 0);
+
+    struct message result;
+    message_init(&result, &settings);
+
+    if (evaluate_tree(&result, &nodes[0], &settings, &pool, &key_eval) == 0) {
+        printf("Result: %ld\n", decrypt_decode(&result, &settings, &key));
+    }
+
+    //Cleanup
+    thread_pool_clear(&pool);
+    message_clear(&result);
+    for (int i = 0; i < 6; i++) {
+        message_clear(&leaves[i]);
+    }
+    key_clear_eval(&key_eval);
+}
+
+void encrypt_eval_dag_decrypt(){
+    //Settings
+    struct settings settings;
+    settings_init_gen_prime(&settings, 10, 200, 2000, 10, 4);
+
+    //Keygen
+    struct key key;
+    keygen(&key, &settings);
+
+    struct key_eval key_eval;
+    key_init_eval(&key_eval, &key, 2);
+
+    //Encrypt x = 3 and y = 4
+    struct message x, y;
+    message_init(&x, &settings);
+    message_init(&y, &settings);
+    encode_encrypt(&x, 3, &settings, &key);
+    encode_encrypt(&y, 4, &settings, &key);
+
+    //r = s * s + s with s = x * y, the common subexpression s is built (and evaluated) once
+    struct dag dag;
+    dag_init(&dag);
+
+    struct node *s = dag_operation(&dag, multiply, dag_value(&dag, 3, &x), dag_value(&dag, 4, &y));
+    struct node *r = dag_operation(&dag, plus, dag_operation(&dag, multiply, s, s), s);
+    struct node *r2 = dag_operation(&dag, plus, s, dag_operation(&dag, multiply, s, s));
+
+    printf("Nodes: %ld, shared: %s\n", dag.count, (r == r2) ? "yes" : "no");
+
+    //Eval
+    struct thread_pool pool;
+    thread_pool_init(&pool, 0);
+
+    struct message result;
+    message_init(&result, &settings);
+
+    if (evaluate_tree(&result, r, &settings, &pool, &key_eval) == 0) {
+        printf("Result: %ld\n", decrypt_decode(&result, &settings, &key));
+    }
+
+    //Cleanup
+    thread_pool_clear(&pool);
+    message_clear(&result);
+    dag_clear(&dag);
+    message_clear(&x);
+    message_clear(&y);
+    key_clear_eval(&key_eval);
+}
+
+void encrypt_eval_tape_decrypt(){
+    //Settings
+    struct settings settings;
+    settings_init_gen_prime(&settings, 10, 200, 2000, 10, 4);
+
+    //Keygen
+    struct key key;
+    keygen(&key, &settings);
+
+    struct key_eval key_eval;
+    key_init_eval(&key_eval, &key, 2);
+
+    //r = (x * y + 2 * 3) * (x * y) + z, the shared x * y is computed once and 2 * 3 is folded
+    struct node x, y, z, two, three, xy, c, t, t_xy, r;
+    set_node(&x, value, 10, NULL, NULL);
+    set_node(&y, value, 10, NULL, NULL);
+    set_node(&z, value, 10, NULL, NULL);
+    set_node(&two, constant, 2, NULL, NULL);
+    set_node(&three, constant, 3, NULL, NULL);
+    set_node(&xy, multiply, 0, &x, &y);
+    set_node(&c, multiply, 0, &two, &three);
+    set_node(&t, plus, 0, &xy, &c);
+    set_node(&t_xy, multiply, 0, &t, &xy);
+    set_node(&r, plus, 0, &t_xy, &z);
+
+    //Compile once
+    struct tape tape;
+    if (tape_compile(&tape, &r, &settings, 1) != 0) {
+        key_clear_eval(&key_eval);
+        return;
+    }
+
+    tape_print(&tape);
+
+    //Run the tape for every batch, the inputs are numbered in post-order (x, y, z)
+    const signed long batches[3][3] = {{1, 2, 3}, {2, 2, -1}, {-3, 1, 5}};
+
+    for (int i = 0; i < 3; i++) {
+        struct message inputs[3];
+        struct message *input_ptrs[3];
+
+        for (int j = 0; j < 3; j++) {
+            message_init(&inputs[j], &settings);
+            encode_encrypt(&inputs[j], batches[i][j], &settings, &key);
+            input_ptrs[j] = &inputs[j];
+        }
+
+        struct message result;
+        message_init(&result, &settings);
+
+        if (tape_run(&result, &tape, input_ptrs, &settings, NULL, &key_eval) == 0) {
+            printf("Result: %ld\n", decrypt_decode(&result, &settings, &key));
+        }
+
+        message_clear(&result);
+        for (int j = 0; j < 3; j++) {
+            message_clear(&inputs[j]);
+        }
+    }
+
+    //Cleanup
+    tape_clear(&tape);
+    key_clear_eval(&key_eval);
+}
+
+void create_params_with_cost_model(){
+    const int m_len = 2;
+    const int m[2] = {1,2};
+    const int rows = 4;
+
+    //Calibrate on this host
+    struct cost_model model;
+    cost_model_init(&model);
+    cost_model_calibrate(&model);
+    cost_model_print(&model);
+
+    //Smallest secure n vs. lowest predicted latency
+    struct settings smallest, fastest;
+    create_tree_and_generate_params(&smallest, my_treefunc, rows, m, m_len, 128, 20, encoding_standard, NULL);
+    create_tree_and_generate_params(&fastest, my_treefunc, rows, m, m_len, 128, 20, encoding_standard, &model);
+
+    struct node root;
+    root.type = plus;
+    my_treefunc(&root, rows, m);
+
+    settings_print(smallest);
+    printf("Predicted latency: %.3f ms\n", predict_latency(&model, &root, &smallest) / 1e6);
+    settings_print(fastest);
+    printf("Predicted latency: %.3f ms\n", predict_latency(&model, &root, &fastest) / 1e6);
+
+    free_tree(&root);
+}
+
+void print_prime_table(){
+    printf("Failed entries: %d\n", prime_table_verify());
+
+    //Single 200 bit prime for n = 2^14
+    fmpz_t q, psi;
+    fmpz_init(q);
+    fmpz_init(psi);
+
+    if (prime_table_lookup(q, psi, 14, 200) == 0) {
+        printf("q: "), fmpz_print(q), printf("\n");
+        printf("psi: "), fmpz_print(psi), printf("\n");
+    }
+
+    fmpz_clear(q);
+    fmpz_clear(psi);
+
+    //RNS chain of word-sized primes for n = 2^14
+    const struct prime_chain *chain = prime_table_chain(14);
+    for (unsigned long i = 0; i < chain->length; i++) {
+        printf("q_%lu: %lu, psi_%lu: %lu\n", i, chain->moduli[i], i, chain->psi[i]);
+    }
+}
+
+void instrumented_evaluation(){
+    struct settings settings;
+    settings_init_gen_prime(&settings, 10, 110, 2000, 10, 4);
+
+    //Count only the evaluation, not the setup (requires -DPLWE_INSTRUMENT)
+    instrument_reset();
+
+    struct key key;
+    keygen(&key, &settings);
+
+    struct message enc1, enc2;
+    message_init(&enc1, &settings);
+    message_init(&enc2, &settings);
+    encode_encrypt(&enc1, 2, &settings, &key);
+    encode_encrypt(&enc2, 40, &settings, &key);
+
+    struct key_eval key_eval;
+    key_init_eval(&key_eval, &key, 16);
+
+    eval_mul(&enc1, &enc1, &enc2);                            //Compute 2 * 40 = 80
+    message_relinearize(&enc1, &key_eval);
+    encode_eval_add_plain(&enc1, &enc1, 3, &settings);        //Compute 80 + 3 = 83
+
+    printf("Result: %ld\n", decrypt_decode(&enc1, &settings, &key));
+
+    struct instrument_snapshot snapshot;
+    instrument_snapshot(&snapshot);
+    instrument_dump(stdout, &snapshot);
+
+    key_clear_eval(&key_eval);
+    message_clear(&enc1);
+    message_clear(&enc2);
+}
+
 //Main
 int main() {
     ///Sampling
@@ -411,13 +1098,28 @@ int main() {
     ///Encryption
     //encrypt_eval_decrypt();
     //encrypt_eval_relin_decrypt();
+    //encrypt_eval_mod_switch_decrypt();
+    //encrypt_sym_serialize_decrypt();
+    //encrypt_eval_batch_decrypt();
+    //encrypt_eval_packed_decrypt();
+    //encrypt_eval_plain_cached_decrypt();
+    //encrypt_eval_sparse_secret_decrypt();
+    //encrypt_eval_tree_decrypt();
+    //encrypt_eval_rebalanced_chain_decrypt();
+    //encrypt_eval_dag_decrypt();
+    //encrypt_eval_tape_decrypt();
     //encrypt_eval_plain_decrypt();
     //threaded_addition();
+    //thread_pool_evaluation();
+    //async_evaluation();
     //time_measurement();
+    //instrumented_evaluation();
 
     ///Misc
     //key_save_load();
     //create_params_for_sample_tree();
+    //create_params_with_cost_model();
+    //print_prime_table();
 
     return 0;
 }